@@ -12,6 +12,10 @@
 #include <array>
 #include <cmath>
 #include <functional>
+#include <algorithm>
+#include <random>
+#include <thread>
+#include <cstdint>
 
 using namespace std;
 
@@ -287,16 +291,14 @@ float chi_squared_fit(vector <array<double, 2>> data, const int size, float m, f
 }
 
 /**
- * @brief Calculates the least squares fit for a given set of data points, given by NΣxy - ΣxΣy / NΣx^2 - (Σx)^2
+ * @brief Calculates the least squares gradient and y-intercept, m = (NΣxy - ΣxΣy) / (NΣx^2 - (Σx)^2) and c = (Σy - mΣx) / N
  * 
- * @param data The vector of data points, where each data point is represented as an array of size 2.
- *             The first element of the array represents the x-coordinate, and the second element represents the y-coordinate.
- * @return The equation of the least squares fit in the form "y = mx + c", where m is the gradient and c is the y-intercept.
+ * @param data The vector of data points [x, y].
+ * @return {m, c}, NaN if every x-value is the same.
  */
-string least_squares_fit(vector <array<double, 2>> &data) {
-    
+array<double, 2> fit_line(const vector <array<double, 2>> &data) {
     const int size = data.size();
-    double sum_x, sum_y, sum_x_y, sum_x_squared = 0; // initialise variables
+    double sum_x = 0, sum_y = 0, sum_x_y = 0, sum_x_squared = 0; // initialise variables
 
     for (int i = 0; i < size; i++) { // loop through data vector
         sum_x += data[i][0]; // sum x-values through the loop
@@ -305,10 +307,96 @@ string least_squares_fit(vector <array<double, 2>> &data) {
         sum_x_squared += data[i][0]*data[i][0]; // sum x^2-values through the loop
     }
 
-    float m = (size*sum_x_y - sum_x*sum_y) / (size*sum_x_squared - sum_x*sum_x); // calculate gradient
-    float c = (sum_y - m*sum_x) / size; // calculate y-intercept
+    double m = (size*sum_x_y - sum_x*sum_y) / (size*sum_x_squared - sum_x*sum_x); // calculate gradient
+    double c = (sum_y - m*sum_x) / size; // calculate y-intercept
+    return {m, c};
+}
+
+/**
+ * @brief SplitMix64 of (seed, replicate), the same stream seeding as the Ex3_4 bootstrap, so neighbouring replicates
+ * get unrelated Mersenne Twister states.
+ * 
+ * @param seed The base random seed.
+ * @param r The replicate number.
+ * @return The seed of replicate r.
+ */
+static uint64_t replicate_seed(uint64_t seed, uint64_t r) {
+    uint64_t z = seed + (r + 1) * 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+/**
+ * @brief Bootstrap uncertainty on the least squares gradient. The data are resampled with replacement and refit
+ * replicates times, split across the hardware threads. Each thread fills one scratch vector for all of its replicates,
+ * and replicate r draws from a generator seeded from (seed, r) by replicate_seed, so the result doesn't depend on the number of threads.
+ * 
+ * @param data The vector of data points [x, y].
+ * @param replicates The number of resamples.
+ * @param cl The confidence level of the percentile interval.
+ * @param seed The base random seed.
+ * @return {standard deviation of the gradients, lower edge, upper edge of the interval}, all NaN with fewer than two
+ *         points or replicates.
+ */
+array<double, 3> bootstrap_gradient(const vector <array<double, 2>> &data, int replicates, double cl, unsigned long seed) {
+    if (data.size() < 2 || replicates < 2) return {NAN, NAN, NAN}; // no line to resample, or no spread to measure
+
+    vector<double> gradients(replicates);
+    int n_threads = max(1u, thread::hardware_concurrency());
+
+    auto worker = [&](int begin, int end) {
+        vector <array<double, 2>> sample(data.size()); // scratch buffer reused by every replicate on this thread
+        mt19937_64 gen;
+        uniform_int_distribution<int> pick(0, data.size() - 1);
+        for (int r = begin; r < end; r++) {
+            gen.seed(replicate_seed(seed, r));
+            for (auto &point : sample) point = data[pick(gen)];
+            gradients[r] = fit_line(sample)[0];
+        }
+    };
+
+    vector<thread> threads;
+    for (int t = 0; t < n_threads; t++) {
+        threads.emplace_back(worker, replicates*t/n_threads, replicates*(t+1)/n_threads);
+    }
+    for (auto &t : threads) t.join();
+
+    // drop resamples where every x was the same
+    gradients.erase(remove_if(gradients.begin(), gradients.end(), [](double m) {return !isfinite(m);}), gradients.end());
+    if (gradients.size() < 2) return {NAN, NAN, NAN};
+
+    double mean = 0, variance = 0;
+    for (double m : gradients) mean += m / gradients.size();
+    for (double m : gradients) variance += (m - mean)*(m - mean) / (gradients.size() - 1);
+
+    sort(gradients.begin(), gradients.end());
+    auto quantile = [&gradients](double q) { // linear interpolation between sorted gradients
+        double pos = q*(gradients.size() - 1);
+        int lo = floor(pos);
+        int hi = min<int>(lo + 1, gradients.size() - 1);
+        return gradients[lo] + (pos - lo)*(gradients[hi] - gradients[lo]);
+    };
+    return {sqrt(variance), quantile((1 - cl)/2), quantile((1 + cl)/2)};
+}
+
+/**
+ * @brief Calculates the least squares fit for a given set of data points, given by NΣxy - ΣxΣy / NΣx^2 - (Σx)^2
+ * 
+ * @param data The vector of data points, where each data point is represented as an array of size 2.
+ *             The first element of the array represents the x-coordinate, and the second element represents the y-coordinate.
+ * @return The equation of the least squares fit in the form "y = mx + c", where m is the gradient and c is the y-intercept,
+ *         with the reduced chi-squared and a bootstrap interval on the gradient.
+ */
+string least_squares_fit(vector <array<double, 2>> &data) {
+    
+    const int size = data.size();
+    array<double, 2> fit = fit_line(data);
+    float m = fit[0]; // gradient
+    float c = fit[1]; // y-intercept
 
     float chi = chi_squared_fit(data, size, m, c); // calculate reduced chi-squared value
+    array<double, 3> m_boot = bootstrap_gradient(data, 1000, 0.6827, 1); // bootstrap spread and 68% interval on the gradient
 
     string lsf = "y = " + to_string(m) + "x + " + to_string(c); // strings for printing and file output
     string lsf_file_format = 
@@ -317,7 +405,10 @@ string least_squares_fit(vector <array<double, 2>> &data) {
         "Reduced χ2 (chi-squared) = " + to_string(chi) + "\n\n"
         "Fit parameters:\n"
         "\tm = " + to_string(m) + "\n"
-        "\tc = " + to_string(c); // format string for file output
+        "\tc = " + to_string(c) + "\n\n"
+        "Bootstrap (1000 resamples):\n"
+        "\tσ_m = " + to_string(m_boot[0]) + "\n"
+        "\t68% interval on m = [" + to_string(m_boot[1]) + ", " + to_string(m_boot[2]) + "]"; // format string for file output
 
     return lsf_file_format; // return string
 }
@@ -19,6 +19,8 @@ struct fileData {
 
 fileData read_file(std::string);
 std::vector<float> calculate_magnitude(std::vector<std::array<double, 2>>&);
+std::array<double, 2> fit_line(const std::vector<std::array<double, 2>>&);
+std::array<double, 3> bootstrap_gradient(const std::vector<std::array<double, 2>>&, int = 1000, double = 0.6827, unsigned long = 1);
 std::string least_squares_fit(std::vector<std::array<double, 2>>&);
 std::vector<float> custom_power(std::vector<std::array<double, 2>>&);
 
@@ -0,0 +1,323 @@
+/**
+ * @file Benchmark.cxx
+ * @author Kierran Falloon (kierran.falloon@strath.ac.uk)
+ * @date 05-12-2023
+ *
+ * Timings for the FiniteFunction hot paths (integral at several Ndiv, scanFunction, makeHist, MetropolisHastings)
+ * for each CustomFunctions distribution, plus the static against virtual dispatch, spline table, quasi-Monte Carlo
+ * and grid scan comparisons. Every benchmark is repeated and the median, min and max are reported.
+ * Build with make bench, then
+ *   ./Benchmark.out [--reps N] [--json results.json] [--baseline old.json] [--tolerance 0.1]
+ * --baseline compares each median against an earlier --json file and exits with 1 if anything got slower than the
+ * tolerance allows.
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <chrono>
+#include <complex>
+#include <random>
+#include <string>
+#include <vector>
+#include "CustomFunctions.h"
+#include "StaticFunctions.h"
+#include "FitFunctions.h"
+#include "GridScan.h"
+#include "QuasiMonteCarlo.h"
+#include "KernelDensity.h"
+
+volatile double g_Sink; // Results are written here so the compiler can't drop the timed work
+
+/*
+###################
+//Harness
+###################
+*/
+
+struct Measurement {
+  std::string name;
+  std::string unit; // ns/eval (lower is better), samples/s or ESS/s (higher is better)
+  std::vector<double> values; // One per repetition
+  double median() const {
+    std::vector<double> v = values;
+    std::sort(v.begin(), v.end());
+    return v.size() % 2 ? v[v.size()/2] : 0.5*(v[v.size()/2 - 1] + v[v.size()/2]);
+  }
+  double min() const {return *std::min_element(values.begin(), values.end());}
+  double max() const {return *std::max_element(values.begin(), values.end());}
+  bool higherIsBetter() const {return unit != "ns/eval";}
+};
+
+class Harness{
+
+public:
+  Harness(int reps) {m_Reps = std::max(1, reps);};
+  int reps() {return m_Reps;};
+
+  // Nanoseconds per evaluation of kernel(), which does nEvals evaluations, once per repetition.
+  // setup() runs untimed before each repetition (e.g. to clear a cached integral).
+  template <typename F, typename S>
+  void time(std::string name, long nEvals, F kernel, S setup) {
+    for (int r = 0; r < m_Reps; r++) {
+      setup();
+      auto start = std::chrono::steady_clock::now();
+      g_Sink = kernel();
+      auto stop = std::chrono::steady_clock::now();
+      this->record(name, "ns/eval", std::chrono::duration<double, std::nano>(stop - start).count() / nEvals);
+    }
+  }
+  template <typename F>
+  void time(std::string name, long nEvals, F kernel) {this->time(name, nEvals, kernel, []() {});}
+
+  void record(std::string name, std::string unit, double value) {
+    for (Measurement &m : m_Results) {
+      if (m.name == name && m.unit == unit) {m.values.push_back(value); return;}
+    }
+    m_Results.push_back({name, unit, {value}});
+  }
+
+  void print() {
+    std::cout << std::endl << "Benchmark (" << m_Reps << " repetitions, median [min, max])" << std::endl;
+    for (Measurement &m : m_Results) {
+      std::cout << "  " << m.name << ": " << m.median() << " " << m.unit << " [" << m.min() << ", " << m.max() << "]" << std::endl;
+    }
+  }
+
+  void writeJSON(std::string filename) {
+    std::ofstream out(filename);
+    out.precision(10);
+    out << "{" << std::endl << "  \"reps\": " << m_Reps << "," << std::endl << "  \"results\": [" << std::endl;
+    for (int i = 0; i < m_Results.size(); i++) {
+      Measurement &m = m_Results[i];
+      out << "    {\"name\": \"" << m.name << "\", \"unit\": \"" << m.unit << "\", \"median\": " << m.median() << ", \"min\": " << m.min() << ", \"max\": " << m.max() << ", \"values\": [";
+      for (int v = 0; v < m.values.size(); v++) out << (v ? ", " : "") << m.values[v];
+      out << "]}" << (i+1 < m_Results.size() ? "," : "") << std::endl;
+    }
+    out << "  ]" << std::endl << "}" << std::endl;
+    std::cout << "LOG: Results written to " << filename << std::endl;
+  }
+
+  // Speed-up of each median against the baseline file (>1 is faster), returns the number of regressions
+  int compare(std::string filename, double tolerance) {
+    std::ifstream in(filename);
+    if (!in.is_open()) {
+      std::cout << "Could not open baseline " << filename << std::endl;
+      exit(1);
+    }
+    // Only needs to read back what writeJSON writes: one result object per line
+    auto field = [](const std::string &line, std::string key) {
+      std::size_t at = line.find("\"" + key + "\": ");
+      if (at == std::string::npos) return std::string();
+      at += key.size() + 4;
+      if (line[at] == '"') return line.substr(at + 1, line.find('"', at + 1) - at - 1);
+      return line.substr(at, line.find_first_of(",}", at) - at);
+    };
+    std::vector<Measurement> base;
+    std::string line;
+    while (std::getline(in, line)) {
+      if (field(line, "name").empty()) continue;
+      base.push_back({field(line, "name"), field(line, "unit"), {std::stod(field(line, "median"))}});
+    }
+
+    int regressions = 0;
+    std::cout << std::endl << "Comparison with " << filename << " (speed-up, tolerance " << tolerance << ")" << std::endl;
+    for (Measurement &m : m_Results) {
+      auto match = std::find_if(base.begin(), base.end(), [&m](const Measurement &b) {return b.name == m.name && b.unit == m.unit;});
+      if (match == base.end()) {
+        std::cout << "  " << m.name << " (" << m.unit << "): not in baseline" << std::endl;
+        continue;
+      }
+      double old = match->values[0];
+      double speedup = m.higherIsBetter() ? m.median()/old : old/m.median();
+      bool regressed = speedup < 1 - tolerance;
+      regressions += regressed;
+      std::cout << "  " << m.name << ": " << old << " -> " << m.median() << " " << m.unit << ", x" << speedup << (regressed ? "  REGRESSION" : "") << std::endl;
+    }
+    return regressions;
+  }
+
+private:
+  int m_Reps;
+  std::vector<Measurement> m_Results;
+};
+
+// Effective sample size n/tau of a chain, tau = 1 + 2*sum(rho_k) with the autocorrelations from an FFT and the sum
+// cut off at the first negative pair rho_2k + rho_2k+1 (Geyer's initial positive sequence)
+double effective_sample_size(const std::vector<double> &chain) {
+  int n = chain.size();
+  if (n < 4) return n;
+  double mean = 0;
+  for (double x : chain) mean += x/n;
+  int m = 1;
+  while (m < 2*n) m <<= 1; // Zero padding so the correlation doesn't wrap around
+  std::vector< std::complex<double> > a(m, 0.0);
+  for (int i = 0; i < n; i++) a[i] = chain[i] - mean;
+  fft(a);
+  for (auto &c : a) c = std::norm(c);
+  fft(a, true);
+  double c0 = a[0].real();
+  if (c0 <= 0) return n;
+  double tau = -1;
+  for (int k = 0; k + 1 < n; k += 2) {
+    double pair = (a[k].real() + a[k+1].real())/c0;
+    if (pair < 0) break;
+    tau += 2*pair;
+  }
+  return n / std::max(tau, 1.0/n);
+}
+
+// Exposes the protected makeHist of a distribution for timing
+template <typename T>
+struct HistProbe : public T {
+  using T::T;
+  using T::makeHist;
+};
+
+/*
+###################
+//Benchmarks
+###################
+*/
+
+// integral() at several Ndiv (cache cleared each time), scanFunction, makeHist and MetropolisHastings::sample
+template <typename T>
+void hot_paths(Harness &harness, std::string name, HistProbe<T> &function) {
+  std::vector<double> params = function.getParameters();
+  auto clearCache = [&]() {function.setParameters(params);}; // Resets the cached integral
+  for (int Ndiv : {1000, 100000, 10000000}) {
+    harness.time("integral/" + name + "/Ndiv=" + std::to_string(Ndiv), Ndiv+1, [&]() {return function.integral(Ndiv);}, clearCache);
+  }
+
+  const int Nscan = 1000000;
+  function.integral(1000);
+  harness.time("scanFunction/" + name, Nscan, [&]() {return function.scanFunction(Nscan).back().second;});
+
+  std::mt19937_64 gen(1);
+  std::uniform_real_distribution<double> uniform(function.rangeMin(), function.rangeMax());
+  std::vector<double> points(1000000);
+  for (double &x : points) x = uniform(gen);
+  harness.time("makeHist/" + name, points.size(), [&]() {return function.makeHist(points, 100)[50].second;});
+
+  // Metropolis: accepted samples per second, and effective (independent) samples per second
+  const int nSamples = 100000;
+  for (int r = 0; r < harness.reps(); r++) {
+    MetropolisHastings sampler(&function, nSamples, r+1);
+    auto start = std::chrono::steady_clock::now();
+    std::vector<double> chain = sampler.sample();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    g_Sink = chain.back();
+    harness.record("metropolis/" + name, "samples/s", chain.size()/seconds);
+    harness.record("metropolis/" + name, "ESS/s", effective_sample_size(chain)/seconds);
+  }
+}
+
+// Integrate and Metropolis kernels with the static density and with the virtual wrapper around function
+template <Density D>
+void dispatch(Harness &harness, std::string name, const D &density, FiniteFunction &function) {
+  const int Ndiv = 1000000;
+  const int nSamples = 200000;
+  const double min = function.rangeMin(), max = function.rangeMax();
+  VirtualDensity virtualDensity{&function};
+  harness.time("integrate_density/" + name + "/static", Ndiv+1, [&]() {return integrate_density(density, min, max, Ndiv);});
+  harness.time("integrate_density/" + name + "/virtual", Ndiv+1, [&]() {return integrate_density(virtualDensity, min, max, Ndiv);});
+
+  std::mt19937_64 genStatic(1), genVirtual(1); // Same stream so both chains do identical work
+  harness.time("metropolis_density/" + name + "/static", nSamples, [&]() {return metropolis_density(density, min, max, nSamples, 1.0, 0.0, genStatic).back();});
+  harness.time("metropolis_density/" + name + "/virtual", nSamples, [&]() {return metropolis_density(virtualDensity, min, max, nSamples, 1.0, 0.0, genVirtual).back();});
+}
+
+// Spline table against direct evaluation, both through the virtual interface
+void tabulated(Harness &harness, std::string name, FiniteFunction &function) {
+  const int Ndiv = 1000000;
+  const double min = function.rangeMin(), max = function.rangeMax();
+  TabulatedFunction table(&function, "Bench-Table", 1e-8);
+  VirtualDensity direct{&function}, lookup{&table};
+  std::cout << name << " tabulated: " << table.nKnots() << " knots, max rel error " << table.maxRelError() << (table.converged() ? "" : " (target NOT reached)") << std::endl;
+  harness.time("tabulated/" + name + "/direct", Ndiv+1, [&]() {return integrate_density(direct, min, max, Ndiv);});
+  harness.time("tabulated/" + name + "/table", Ndiv+1, [&]() {return integrate_density(lookup, min, max, Ndiv);});
+}
+
+// Randomised QMC integral() against Simpson at a comparable accuracy, nEvals counts the points of every replicate
+void qmc(Harness &harness, std::string name, FiniteFunction &function) {
+  std::vector<double> params = function.getParameters();
+  auto clearCache = [&]() {function.setParameters(params);};
+  const double width = function.rangeMax() - function.rangeMin();
+  for (Sequence sequence : {Sequence::Sobol, Sequence::Halton}) {
+    std::string label = (sequence == Sequence::Sobol) ? "Sobol" : "Halton";
+    QMCResult probe = qmc_integrate([&](const double* u, int n, double* out) {
+      std::vector<double> x(n);
+      for (int i = 0; i < n; i++) x[i] = function.rangeMin() + u[i]*width;
+      function.batchFunction(x.data(), out, n);
+    }, 1, 1e-8, sequence);
+    std::cout << name << " " << label << ": " << probe.nPoints << " points x " << probe.nReplicates << " replicates, relative error " << probe.error/std::abs(probe.value) << std::endl;
+    function.setIntegrator(sequence == Sequence::Sobol ? Integrator::Sobol : Integrator::Halton, 1e-8);
+    harness.time("integral_qmc/" + name + "/" + label, probe.nPoints*probe.nReplicates, [&]() {return function.integral();}, clearCache);
+  }
+  function.setIntegrator(Integrator::Simpson);
+}
+
+// Tiled grid scan against one UnbinnedFitter::nll call per cell, over the same 41x41 grid of Normal parameters
+void grid(Harness &harness, FiniteFunction &function) {
+  std::mt19937_64 gen(1);
+  std::normal_distribution<double> normal(2.0, 1.5);
+  std::vector<double> data(100000);
+  for (double &x : data) x = normal(gen);
+  std::vector<GridAxis> axes = {grid_axis(0, 2.0, 0.1, 41), grid_axis(1, 1.5, 0.1, 41)};
+  long nEvals = 41*41*(long)data.size();
+
+  harness.time("grid/Normal/scan_nll", nEvals, [&]() {return scan_nll(&function, data, axes).minimum();});
+  UnbinnedFitter fitter(&function, data);
+  GridScanResult cells; // Only used to decode the cell index
+  cells.axes = axes;
+  cells.fixed = function.getParameters();
+  harness.time("grid/Normal/nll_per_cell", nEvals, [&]() {
+    double best = 1e300;
+    for (long c = 0; c < 41*41; c++) best = std::min(best, fitter.nll(cells.parameters(c)));
+    return best;
+  });
+  function.setParameters(cells.fixed);
+}
+
+int main(int argc, char *argv[]) {
+  int reps = 5;
+  std::string json, baseline;
+  double tolerance = 0.1;
+  for (int i = 1; i < argc; i += 2) {
+    std::string flag = argv[i];
+    if (i + 1 >= argc) {
+      std::cout << "Missing value for " << flag << std::endl;
+      return 1;
+    }
+    if (flag == "--reps") reps = std::stoi(argv[i+1]);
+    else if (flag == "--json") json = argv[i+1];
+    else if (flag == "--baseline") baseline = argv[i+1];
+    else if (flag == "--tolerance") tolerance = std::stod(argv[i+1]);
+    else {
+      std::cout << "Unknown option " << flag << std::endl;
+      return 1;
+    }
+  }
+
+  Harness harness(reps);
+  HistProbe<NormalDistributionFunction> normalFunc(-7, 11, "Bench-Normal", 2.0, 1.5);
+  HistProbe<CauchyLorentzDistribution> cauchyFunc(-7, 11, "Bench-Cauchy", 2.0, 1.0);
+  HistProbe<NegativeCrystalBallDistribution> crystalFunc(-7, 11, "Bench-Crystal", 2.0, 1.5, 2.0, 2.0);
+
+  hot_paths(harness, "Normal", normalFunc);
+  hot_paths(harness, "Cauchy-Lorentz", cauchyFunc);
+  hot_paths(harness, "Negative-Crystal", crystalFunc);
+  dispatch(harness, "Normal", NormalDensity(2.0, 1.5), normalFunc);
+  dispatch(harness, "Cauchy-Lorentz", CauchyLorentzDensity(2.0, 1.0), cauchyFunc);
+  dispatch(harness, "Negative-Crystal", NegativeCrystalBallDensity(2.0, 1.5, 2.0, 2.0), crystalFunc);
+  tabulated(harness, "Negative-Crystal", crystalFunc);
+  qmc(harness, "Normal", normalFunc);
+  qmc(harness, "Negative-Crystal", crystalFunc);
+  grid(harness, normalFunc);
+
+  harness.print();
+  if (!json.empty()) harness.writeJSON(json);
+  if (!baseline.empty() && harness.compare(baseline, tolerance) > 0) return 1;
+  return 0;
+}
@@ -0,0 +1,144 @@
+/**
+ * @file Bootstrap.cxx
+ * @author Kierran Falloon (kierran.falloon@strath.ac.uk)
+ * @date 05-12-2023
+ */
+
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include "Bootstrap.h"
+#include "CustomFunctions.h"
+#include "FitFunctions.h"
+#include "Parallel.h"
+
+// Fill sample with n draws with replacement from data
+static void resample(const std::vector<double> &data, std::vector<double> &sample, std::mt19937_64 &gen) {
+  std::uniform_int_distribution<long> pick(0, data.size() - 1);
+  for (double &x : sample) x = data[pick(gen)];
+}
+
+// Refit every replicate with density D built by make(params). One resample buffer, generator and simplex scratch per
+// thread, and the objective is a plain lambda, so the replicate loop doesn't allocate.
+template <typename D, typename Make>
+static void refit_static(Make make, const std::vector<double> &data, double min, double max, const std::vector<double> &start, const std::vector<double> &steps, unsigned long seed, std::vector<std::vector<double>> &fits, std::vector<char> &ok, int nThreads) {
+  const double inf = std::numeric_limits<double>::infinity();
+  const int intDiv = 1000; // Same normalisation as UnbinnedFitter
+  long nReplicates = fits.size();
+  for (std::vector<double> &fit : fits) fit.resize(start.size());
+  parallel_for(nReplicates, [&](long begin, long end, int) {
+    std::vector<double> sample(data.size());
+    std::mt19937_64 gen;
+    SimplexScratch scratch;
+    auto nll = [&](const std::vector<double> &p) {
+      D density = make(p);
+      double integral = integrate_density(density, min, max, intDiv);
+      if (!(integral > 0) || !std::isfinite(integral)) return inf;
+      double sum = 0;
+      for (double x : sample) sum += density.logValue(x);
+      double value = -sum + sample.size()*log(integral);
+      return std::isfinite(value) ? value : inf;
+    };
+    for (long r = begin; r < end; r++) {
+      gen.seed(stream_seed(seed, r));
+      resample(data, sample, gen);
+      int nCalls;
+      bool converged;
+      minimise_with(nll, start, steps, fits[r], scratch, nCalls, converged);
+      ok[r] = converged;
+    }
+  }, nThreads, 1);
+}
+
+BootstrapResult bootstrap_fit(FiniteFunction* function, std::vector<double> &data, int nReplicates, double cl, unsigned long seed, int nThreads) {
+  BootstrapResult result;
+  result.cl = cl;
+  UnbinnedFitter fitter(function, data, nThreads);
+  FitResult central = fitter.fit();
+  result.names = central.names;
+  result.values = central.values;
+  result.hessianErrors = central.errors;
+
+  // Start each refit at the central fit with a simplex about one standard error across
+  std::vector<double> steps;
+  for (int i = 0; i < central.values.size(); i++) {
+    double e = central.errors[i];
+    steps.push_back(std::isfinite(e) && e > 0 ? e : std::max(0.1*std::abs(central.values[i]), 0.1));
+  }
+
+  const double min = function->rangeMin(), max = function->rangeMax();
+  std::vector<double> inRange;
+  for (double x : data) {
+    if (x >= min && x <= max) inRange.push_back(x);
+  }
+
+  std::vector<std::vector<double>> fits(nReplicates);
+  std::vector<char> ok(nReplicates, 0);
+  if (dynamic_cast<NormalDistributionFunction*>(function)) {
+    refit_static<NormalDensity>([](const std::vector<double> &p) {return NormalDensity(p[0], p[1]);}, inRange, min, max, central.values, steps, seed, fits, ok, nThreads);
+  }
+  else if (dynamic_cast<CauchyLorentzDistribution*>(function)) {
+    refit_static<CauchyLorentzDensity>([](const std::vector<double> &p) {return CauchyLorentzDensity(p[0], p[1]);}, inRange, min, max, central.values, steps, seed, fits, ok, nThreads);
+  }
+  else if (dynamic_cast<NegativeCrystalBallDistribution*>(function)) {
+    auto make = [](const std::vector<double> &p) {return NegativeCrystalBallDensity(p[0], p[1], p[2], p[3] > 1 ? p[3] : NAN);}; // NaN n gives an inf NLL, as in UnbinnedFitter
+    refit_static<NegativeCrystalBallDensity>(make, inRange, min, max, central.values, steps, seed, fits, ok, nThreads);
+  }
+  else if (!central.values.empty()) { // The function holds its parameters, so replicates have to take turns
+    std::vector<double> sample(inRange.size());
+    std::mt19937_64 gen;
+    for (int r = 0; r < nReplicates; r++) {
+      gen.seed(stream_seed(seed, r));
+      resample(inRange, sample, gen);
+      UnbinnedFitter replicate(function, sample, nThreads);
+      function->setParameters(central.values);
+      FitResult fit = replicate.fit();
+      fits[r] = fit.values;
+      ok[r] = fit.converged;
+    }
+  }
+  function->setParameters(central.values);
+
+  for (int r = 0; r < nReplicates; r++) {
+    if (ok[r]) result.replicates.push_back(fits[r]);
+  }
+  result.nReplicates = result.replicates.size();
+  result.nFailed = nReplicates - result.nReplicates;
+
+  // Spread and percentile interval of each parameter over the usable replicates
+  for (int i = 0; i < result.values.size(); i++) {
+    std::vector<double> v;
+    for (auto &fit : result.replicates) v.push_back(fit[i]);
+    if (v.size() < 2) {
+      result.errors.push_back(std::numeric_limits<double>::quiet_NaN());
+      result.lower.push_back(std::numeric_limits<double>::quiet_NaN());
+      result.upper.push_back(std::numeric_limits<double>::quiet_NaN());
+      continue;
+    }
+    double mean = 0, var = 0;
+    for (double x : v) mean += x/v.size();
+    for (double x : v) var += (x - mean)*(x - mean)/(v.size() - 1);
+    result.errors.push_back(sqrt(var));
+
+    std::sort(v.begin(), v.end());
+    auto quantile = [&v](double q) { // Linear interpolation between order statistics
+      double pos = q*(v.size() - 1);
+      int lo = std::floor(pos);
+      int hi = std::min<int>(lo + 1, v.size() - 1);
+      return v[lo] + (pos - lo)*(v[hi] - v[lo]);
+    };
+    result.lower.push_back(quantile((1 - cl)/2));
+    result.upper.push_back(quantile((1 + cl)/2));
+  }
+  return result;
+}
+
+void print_bootstrap(const BootstrapResult &result, std::string title) {
+  std::cout << std::endl << title << " bootstrap: " << result.nReplicates << " replicates (" << result.nFailed << " failed), " << 100*result.cl << "% intervals" << std::endl;
+  for (int i = 0; i < result.values.size(); i++) {
+    std::cout << "  " << result.names[i] << " = " << result.values[i] << " +/- " << result.hessianErrors[i] << " (Hessian), +/- " << result.errors[i] << " (bootstrap), interval [" << result.lower[i] << ", " << result.upper[i] << "]" << std::endl;
+  }
+}
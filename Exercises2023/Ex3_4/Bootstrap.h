@@ -0,0 +1,31 @@
+/**
+ * @file Bootstrap.h
+ * @author Kierran Falloon (kierran.falloon@strath.ac.uk)
+ * @date 05-12-2023
+ */
+
+#include <string>
+#include <vector>
+#include "FiniteFunctions.h"
+
+#pragma once
+
+struct BootstrapResult {
+  std::vector<std::string> names; // Parameter names
+  std::vector<double> values; // Unbinned fit to the original data
+  std::vector<double> hessianErrors; // Parabolic errors of that fit, for comparison
+  std::vector<double> errors; // Standard deviation of the replicate fits
+  std::vector<double> lower, upper; // Percentile interval at confidence level cl
+  double cl;
+  int nReplicates; // Replicates that gave a usable fit
+  int nFailed; // Replicates dropped because the refit didn't converge
+  std::vector<std::vector<double>> replicates; // Best fit parameters of each usable replicate
+};
+
+// Fit the function to data, then refit it to nReplicates resamples (with replacement) of the points in range.
+// Replicate r draws from its own generator seeded from (seed, r), so the intervals don't depend on nThreads.
+// The distributions in CustomFunctions.h refit in parallel through their static densities, each thread reusing one
+// resample buffer. Other functions are refit one replicate at a time through UnbinnedFitter.
+// The function is left at the fit to the original data.
+BootstrapResult bootstrap_fit(FiniteFunction* function, std::vector<double> &data, int nReplicates = 1000, double cl = 0.6827, unsigned long seed = 1, int nThreads = 0);
+void print_bootstrap(const BootstrapResult &result, std::string title); // Hessian and bootstrap errors side by side
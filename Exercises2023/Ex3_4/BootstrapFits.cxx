@@ -0,0 +1,52 @@
+/**
+ * @file BootstrapFits.cxx
+ * @author Kierran Falloon (kierran.falloon@strath.ac.uk)
+ * @version 1.0
+ * @date 5-12-2023
+ *
+ * Bootstrap confidence intervals for the Normal, Cauchy-Lorentz and Negative Crystal Ball fits to one data file.
+ * Replicate fits are written to Outputs/data/<model>-Bootstrap.csv for histogramming.
+ * Called via ./BootstrapFits.out [file = Outputs/data/MysteryData04113.txt] [nReplicates = 1000] [nThreads = all]
+ */
+
+#include <iostream>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "CustomFunctions.h"
+#include "HelperFunctions.h"
+#include "Bootstrap.h"
+#include "DataWriter.h"
+
+// Bootstrap one model, print the intervals and dump the replicates
+void run(FiniteFunction &function, std::vector<double> &data, std::string name, int nReplicates, int nThreads) {
+  auto start = std::chrono::steady_clock::now();
+  BootstrapResult result = bootstrap_fit(&function, data, nReplicates, 0.6827, 1, nThreads);
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  print_bootstrap(result, name);
+  std::cout << "  " << seconds << " s" << std::endl;
+
+  std::string header;
+  for (int i = 0; i < result.names.size(); i++) header += (i ? "," : "") + result.names[i];
+  DataWriter writer("Outputs/data/" + name + "-Bootstrap.csv", false, header);
+  for (auto &fit : result.replicates) writer.row(fit.data(), fit.size());
+}
+
+int main(int argc, char *argv[]) {
+  std::string file = argc > 1 ? argv[1] : "Outputs/data/MysteryData04113.txt";
+  int nReplicates = argc > 2 ? std::stoi(argv[2]) : 1000;
+  int nThreads = argc > 3 ? std::stoi(argv[3]) : 0;
+
+  std::vector<double> data = read_file(file, false);
+  Summary stats = summarise(data);
+  std::array<int,2> range = data_range(stats); // Same model range as Test.cxx
+  std::cout << "LOG: " << nReplicates << " replicates of " << data.size() << " points from " << file << std::endl;
+
+  NormalDistributionFunction normalFunc(range[0], range[1], "Normal-Dist", stats.mean, stats.stdev());
+  CauchyLorentzDistribution cauchyFunc(range[0], range[1], "Cauchy-Lorentz", stats.mean, 0.80);
+  NegativeCrystalBallDistribution crystalFunc(range[0], range[1], "Negative-Crystal", stats.mean, stats.stdev(), 2.0, 2.0);
+  run(normalFunc, data, "Normal-Dist", nReplicates, nThreads);
+  run(cauchyFunc, data, "Cauchy-Lorentz", nReplicates, nThreads);
+  run(crystalFunc, data, "Negative-Crystal", nReplicates, nThreads);
+  return 0;
+}
@@ -0,0 +1,129 @@
+/**
+ * @file CompareModels.cxx
+ * @author Kierran Falloon (kierran.falloon@strath.ac.uk)
+ * @version 1.0
+ * @date 5-12-2023
+ *
+ * Fits every FiniteFunction model to every Data/MysteryData file, ranks the models for each file by AIC and reports
+ * KS, Anderson-Darling and Cramer-von Mises statistics for each fit.
+ * Called via ./CompareModels.out [data directory = ../../Data] [nThreads = all]
+ */
+
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cmath>
+#include "FiniteFunctions.h"
+#include "CustomFunctions.h"
+#include "HelperFunctions.h"
+#include "FitFunctions.h"
+#include "ThreadPool.h"
+#include "GoodnessOfFit.h"
+
+const std::vector<std::string> model_names = {"Inv-X-Squared", "Normal", "Cauchy-Lorentz", "Negative-Crystal"};
+
+struct ModelResult {
+  std::string file;
+  std::string model;
+  long n = 0; // Points inside the fit range
+  int k = 0; // Number of free parameters
+  FitResult fit;
+  GoodnessOfFit gof;
+  double aic = 0; // 2k + 2NLL
+  double bic = 0; // k ln(n) + 2NLL
+  int rank = 0; // 1 = lowest AIC for this file
+};
+
+// Build model number m with starting parameters from the data moments
+std::unique_ptr<FiniteFunction> make_model(int m, double min, double max, double mean, double sd, std::string name) {
+  switch (m) {
+  case 1: return std::make_unique<NormalDistributionFunction>(min, max, name, mean, sd);
+  case 2: return std::make_unique<CauchyLorentzDistribution>(min, max, name, mean, sd/2);
+  case 3: return std::make_unique<NegativeCrystalBallDistribution>(min, max, name, mean, sd, 2.0, 2.0);
+  default: return std::make_unique<FiniteFunction>(min, max, name);
+  }
+}
+
+// Fit one model to one file's (sorted) data and fill in the information criteria and goodness of fit
+ModelResult fit_model(std::string file, int m, std::vector<double> &data) {
+  Summary stats = summarise(data, 1);
+  std::array<int,2> range = data_range(stats);
+  std::unique_ptr<FiniteFunction> model = make_model(m, range[0], range[1], stats.mean, stats.stdev(), file + "-" + model_names[m]);
+
+  UnbinnedFitter fitter(model.get(), data, 1); // The pool already keeps every core busy
+  ModelResult result;
+  result.file = file;
+  result.model = model_names[m];
+  result.n = data.size();
+  result.fit = fitter.fit();
+  result.k = result.fit.values.size();
+  result.aic = 2*result.k + 2*result.fit.minimum;
+  result.bic = result.k*log((double)result.n) + 2*result.fit.minimum;
+  result.gof = goodness_of_fit_sorted(CDFTable(model.get()), data, 1); // data_range covers every point, so all are in range
+  return result;
+}
+
+int main(int argc, char *argv[]) {
+  std::string directory = argc > 1 ? argv[1] : "../../Data";
+  int nThreads = argc > 2 ? std::stoi(argv[2]) : 0;
+
+  std::vector<std::filesystem::path> files;
+  for (auto &entry : std::filesystem::directory_iterator(directory)) {
+    std::string name = entry.path().filename();
+    if (name.rfind("MysteryData", 0) == 0 && entry.path().extension() == ".txt") files.push_back(entry.path());
+  }
+  std::sort(files.begin(), files.end());
+  std::cout << "LOG: Comparing " << model_names.size() << " models on " << files.size() << " files from " << directory << std::endl;
+
+  // One task per file reads it, then submits one task per model. Nested tasks land on the reading worker's deque
+  // and idle workers steal them, so a slow Crystal Ball fit doesn't hold up the rest.
+  auto start = std::chrono::steady_clock::now();
+  std::vector<ModelResult> results(files.size()*model_names.size());
+  {
+    ThreadPool pool(nThreads);
+    for (int f = 0; f < files.size(); f++) {
+      pool.submit([&, f]() {
+        auto data = std::make_shared< std::vector<double> >(read_file(files[f].string(), false));
+        parallel_sort(*data, 1); // Sorted once, shared by the four goodness of fit tests
+        std::string stem = files[f].stem();
+        for (int m = 0; m < model_names.size(); m++) {
+          pool.submit([&, f, m, data, stem]() {results[f*model_names.size() + m] = fit_model(stem, m, *data);});
+        }
+      });
+    }
+    pool.wait();
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  // Rank models within each file by AIC
+  for (int f = 0; f < files.size(); f++) {
+    auto first = results.begin() + f*model_names.size();
+    std::vector<ModelResult*> order;
+    for (auto it = first; it != first + model_names.size(); it++) order.push_back(&*it);
+    std::sort(order.begin(), order.end(), [](ModelResult* a, ModelResult* b) {return a->aic < b->aic;});
+    for (int r = 0; r < order.size(); r++) order[r]->rank = r+1;
+  }
+
+  // Summary table
+  std::string outfile = "Outputs/data/ModelComparison.csv";
+  std::ofstream table(outfile);
+  table << "file,model,n,k,nll,aic,bic,rank,ks,ks_p,ad,cvm,converged,parameters" << std::endl;
+  table.precision(10);
+  for (ModelResult &r : results) {
+    table << r.file << "," << r.model << "," << r.n << "," << r.k << "," << r.fit.minimum << "," << r.aic << "," << r.bic << "," << r.rank << "," << r.gof.ks << "," << r.gof.ksPValue << "," << r.gof.ad << "," << r.gof.cvm << "," << r.fit.converged << ",";
+    for (int i = 0; i < r.k; i++) table << (i ? ";" : "") << r.fit.names[i] << "=" << r.fit.values[i];
+    table << std::endl;
+  }
+
+  std::cout << std::endl;
+  for (ModelResult &r : results) {
+    if (r.rank == 1) std::cout << r.file << ": " << r.model << " (AIC " << r.aic << ", BIC " << r.bic << ", KS D " << r.gof.ks << ")" << std::endl;
+  }
+  std::cout << std::endl << "LOG: " << results.size() << " fits in " << seconds << " s, table written to " << outfile << std::endl;
+  return 0;
+}
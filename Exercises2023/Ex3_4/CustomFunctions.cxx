@@ -6,7 +6,12 @@
 
 #include "FiniteFunctions.h"
 #include "CustomFunctions.h"
+#include <iostream>
 #include <random>
+#include <cmath>
+#include <algorithm>
+#include <limits>
+#include "Parallel.h"
 
 /*
 ###################
@@ -21,10 +26,34 @@ double NormalDistributionFunction::getMean(){return m_mu;};
 //Function eval
 ###################
 */
-double NormalDistributionFunction::normal(double x, double mu, double sigma) {
-  return (1/(sigma*sqrt(2*M_PI)))*exp(-0.5*pow((x-mu)/sigma, 2));
+// Evaluation forwards to the cached NormalDensity (StaticFunctions.h), so 1/(sigma*sqrt(2pi)) isn't recomputed per call
+double NormalDistributionFunction::callFunction(double x) {FF_STAT_ADD(m_Stats, calls, 1); return m_Density(x);}
+
+// Flat loop over logValue so the compiler can vectorise it
+void NormalDistributionFunction::logFunction(const double* x, double* out, int n) {
+  FF_STAT_ADD(m_Stats, logEvals, n);
+  const NormalDensity density = m_Density;
+  for (int i = 0; i < n; i++) out[i] = density.logValue(x[i]);
+}
+
+void NormalDistributionFunction::batchFunction(const double* x, double* out, int n) {
+  FF_STAT_ADD(m_Stats, calls, n);
+  const NormalDensity density = m_Density;
+  for (int i = 0; i < n; i++) out[i] = density(x[i]);
+}
+
+/*
+###################
+//Setters
+###################
+*/
+void NormalDistributionFunction::setParameters(std::vector<double> params) {
+  m_mu = params[0];
+  m_sigma = params[1];
+  this->updateDensity();
+  m_Integral = NULL; // Normalisation depends on the parameters
 }
-double NormalDistributionFunction::callFunction(double x) {return this->normal(x, m_mu, m_sigma);}
+void NormalDistributionFunction::updateDensity() {m_Density = NormalDensity(m_mu, m_sigma);}
 
 /*
 ###################
@@ -55,10 +84,32 @@ double CauchyLorentzDistribution::getMean(){return m_x0;};
 //Function eval
 ###################
 */
-double CauchyLorentzDistribution::cauchy(double x, double gamma) {
-  return 1/( (M_PI*gamma) * 1+pow((x-m_x0)/gamma, 2));
+double CauchyLorentzDistribution::callFunction(double x) {FF_STAT_ADD(m_Stats, calls, 1); return m_Density(x);}
+
+void CauchyLorentzDistribution::logFunction(const double* x, double* out, int n) {
+  FF_STAT_ADD(m_Stats, logEvals, n);
+  const CauchyLorentzDensity density = m_Density;
+  for (int i = 0; i < n; i++) out[i] = density.logValue(x[i]);
+}
+
+void CauchyLorentzDistribution::batchFunction(const double* x, double* out, int n) {
+  FF_STAT_ADD(m_Stats, calls, n);
+  const CauchyLorentzDensity density = m_Density;
+  for (int i = 0; i < n; i++) out[i] = density(x[i]);
 }
-double CauchyLorentzDistribution::callFunction(double x) {return this->cauchy(x, m_gamma);};
+
+/*
+###################
+//Setters
+###################
+*/
+void CauchyLorentzDistribution::setParameters(std::vector<double> params) {
+  m_x0 = params[0];
+  m_gamma = params[1];
+  this->updateDensity();
+  m_Integral = NULL; // Normalisation depends on the parameters
+}
+void CauchyLorentzDistribution::updateDensity() {m_Density = CauchyLorentzDensity(m_x0, m_gamma);}
 
 /*
 ###################
@@ -89,22 +140,39 @@ double NegativeCrystalBallDistribution::getMean(){return m_xbar;};
 //Function eval
 ###################
 */
-double NegativeCrystalBallDistribution::negativeCrystalBall(double x, double xbar, double sigma, double alpha, double n) {
-  alpha = abs(alpha);
-  double z = (x-xbar)/sigma; // for convenience
-  double A = pow(n/alpha, n) * exp(-pow(alpha, 2)/2);
-  double B = n/alpha - alpha;
-  double C = n/alpha * (1/(n-1)) * exp(-pow(alpha, 2)/2);
-  double D = sqrt(M_PI/2) * (1 + erf(alpha/sqrt(2)));
-  double N = 1/(sigma * (C+D));
-  if (z <= -alpha) {
-    return N * A * pow(B-z, -n);
-  }
-  else {
-    return N * exp(-pow(z, 2)/2);
+double NegativeCrystalBallDistribution::callFunction(double x) {FF_STAT_ADD(m_Stats, calls, 1); return m_Density(x);} // No pow/exp/erf of the parameters per call
+
+// Gaussian core and power-law tail are picked with a select rather than a branchy call
+void NegativeCrystalBallDistribution::logFunction(const double* x, double* out, int n) {
+  FF_STAT_ADD(m_Stats, logEvals, n);
+  if (m_n <= 1) { // The tail normalisation has 1/(n-1), NaN logs make the NLL inf so fits stay at n > 1
+    std::fill(out, out + n, std::numeric_limits<double>::quiet_NaN());
+    return;
   }
+  const NegativeCrystalBallDensity density = m_Density;
+  for (int i = 0; i < n; i++) out[i] = density.logValue(x[i]);
+}
+
+void NegativeCrystalBallDistribution::batchFunction(const double* x, double* out, int n) {
+  FF_STAT_ADD(m_Stats, calls, n);
+  const NegativeCrystalBallDensity density = m_Density;
+  for (int i = 0; i < n; i++) out[i] = density(x[i]);
 }
-double NegativeCrystalBallDistribution::callFunction(double x) {return this->negativeCrystalBall(x, m_xbar, m_sigma, m_alpha, m_n);};
+
+/*
+###################
+//Setters
+###################
+*/
+void NegativeCrystalBallDistribution::setParameters(std::vector<double> params) {
+  m_xbar = params[0];
+  m_sigma = params[1];
+  m_alpha = params[2];
+  m_n = params[3];
+  this->updateDensity();
+  m_Integral = NULL; // Normalisation depends on the parameters
+}
+void NegativeCrystalBallDistribution::updateDensity() {m_Density = NegativeCrystalBallDensity(m_xbar, m_sigma, m_alpha, m_n);}
 
 /*
 ###################
@@ -135,18 +203,14 @@ MetropolisHastings::~MetropolisHastings() {} // Destructor
 
 // Random number generator
 double MetropolisHastings::random(int min, int max) {
-  std::random_device rd;
-  std::mt19937 gen(rd());
   std::uniform_real_distribution<> dis(min, max);
-  return dis(gen);
+  return dis(m_Gen);
 }
 
 // Random number generator with normal distribution
 double MetropolisHastings::random_normal(double norm_sigma) {
-  std::random_device rd;
-  std::mt19937 gen(rd());
   std::normal_distribution<> dis(m_norm_mean, norm_sigma);
-  return dis(gen);
+  return dis(m_Gen);
 }
 
 //Print
@@ -157,11 +221,13 @@ void MetropolisHastings::printInfo() {
 
 // Metropolis-Hastings algorithm
 std::vector<double> MetropolisHastings::sample() {
+  FF_STAT_TIMER(m_Function->stats(), samplingNs); // Counted against the sampled function
   std::vector<double> m_Samples;
   double x = random(m_RMin, m_RMax); // Initial random x value
 
   while (m_Samples.size() < nSamples) {
     double y = random_normal(2.5); // Random y value from normal distribution with standard deviation
+    FF_STAT_ADD(m_Function->stats(), proposals, 1);
     double fx = m_Function->callFunction(x); // Call function to get f(x)
     double fy = m_Function->callFunction(y); // Call function to get f(y)
     double A = std::min(1.0, fy/fx); 
@@ -170,11 +236,118 @@ std::vector<double> MetropolisHastings::sample() {
     if (T < A) { // Accept y
       m_Samples.push_back(y);
       x = y; // Set next x
+      FF_STAT_ADD(m_Function->stats(), accepted, 1);
     }
     else { // Reject y
       x = x; // Don't change x
+      FF_STAT_ADD(m_Function->stats(), rejected, 1);
     }
   }
 
   return m_Samples;
-}
\ No newline at end of file
+}
+/*
+###################
+//Tabulated spline approximation
+// The range is cut into m_NBlocks equal blocks, and each block gets its own uniform knot grid, doubled until the
+// cubic Hermite spline matches the function to m_RelTol at the 1/8, 2/8, ..., 7/8 points of every segment.
+// The error is only measured there, so m_MaxRelError is an estimate (good for functions that are smooth on the
+// segment scale), not a bound. Lookup is two multiplies to find the block and segment, then a Horner cubic.
+###################
+*/
+
+TabulatedFunction::TabulatedFunction(FiniteFunction* function, std::string outfile, double relTol, int nThreads) : FiniteFunction(function->rangeMin(), function->rangeMax(), outfile) {
+  m_Function = function;
+  m_RelTol = relTol;
+  m_Threads = nThreads;
+  this->build();
+}
+
+bool TabulatedFunction::build() {
+  m_RMin = m_Function->rangeMin();
+  m_RMax = m_Function->rangeMax();
+  const double width = (m_RMax - m_RMin)/m_NBlocks;
+  const double delta = 1e-5*(m_RMax - m_RMin); //Step for the central difference derivatives
+  m_InvBlock = 1/width;
+
+  //Relative error is measured against max(|f|, floor) so zeros of f don't demand infinite precision
+  double fmax = 0;
+  for (int i = 0; i <= 1000; i++) fmax = std::max(fmax, std::abs(m_Function->callFunction(m_RMin + i*(m_RMax - m_RMin)/1000)));
+  const double floor = 1e-9*fmax;
+
+  std::vector< std::vector<double> > blockCoeffs(m_NBlocks);
+  std::vector<double> blockError(m_NBlocks, 0.0);
+  parallel_for(m_NBlocks, [&](long begin, long end, int) {
+    for (long b = begin; b < end; b++) {
+      const double start = m_RMin + b*width;
+      for (int nSeg = 4; nSeg <= m_MaxSeg; nSeg *= 2) {
+        const double h = width/nSeg;
+        std::vector<double> f(nSeg+1), d(nSeg+1);
+        for (int i = 0; i <= nSeg; i++) {
+          double x = start + i*h;
+          f[i] = m_Function->callFunction(x);
+          d[i] = (m_Function->callFunction(x + delta) - m_Function->callFunction(x - delta))/(2*delta) * h; //Slope in t
+        }
+        std::vector<double> coeffs(4*nSeg);
+        double worst = 0;
+        for (int i = 0; i < nSeg; i++) {
+          double* c = &coeffs[4*i];
+          c[0] = f[i];
+          c[1] = d[i];
+          c[2] = 3*(f[i+1] - f[i]) - 2*d[i] - d[i+1];
+          c[3] = 2*(f[i] - f[i+1]) + d[i] + d[i+1];
+          for (int k = 1; k < 8; k++) {
+            double t = k/8.0;
+            double exact = m_Function->callFunction(start + (i+t)*h);
+            double spline = c[0] + t*(c[1] + t*(c[2] + t*c[3]));
+            worst = std::max(worst, std::abs(spline - exact)/std::max(std::abs(exact), floor));
+          }
+        }
+        blockCoeffs[b] = coeffs;
+        blockError[b] = worst;
+        if (worst <= m_RelTol) break;
+      }
+    }
+  }, m_Threads, 1);
+
+  m_Blocks.clear();
+  m_Coeffs.clear();
+  m_MaxRelError = 0;
+  for (int b = 0; b < m_NBlocks; b++) {
+    int nSeg = blockCoeffs[b].size()/4;
+    m_Blocks.push_back({m_RMin + b*width, nSeg/width, (int)m_Coeffs.size()/4, nSeg});
+    m_Coeffs.insert(m_Coeffs.end(), blockCoeffs[b].begin(), blockCoeffs[b].end());
+    m_MaxRelError = std::max(m_MaxRelError, blockError[b]);
+  }
+  m_Integral = NULL;
+  return this->converged();
+}
+
+//Indices are clamped (in double, so NaN and huge x can't overflow the cast) rather than range checked, so there are
+//no branches in the lookup. Outside the range the edge cubics are extrapolated and NaN stays NaN through t.
+double TabulatedFunction::callFunction(double x) {
+  FF_STAT_ADD(m_Stats, calls, 1);
+  int b = static_cast<int>(std::fmin(std::fmax((x - m_RMin)*m_InvBlock, 0.0), m_NBlocks-1)); //fmax(NaN, 0) is 0
+  const Block &block = m_Blocks[b];
+  double u = (x - block.start)*block.invH;
+  int i = static_cast<int>(std::fmin(std::fmax(u, 0.0), block.nSeg-1));
+  double t = u - i;
+  const double* c = &m_Coeffs[4*(block.offset + i)];
+  return c[0] + t*(c[1] + t*(c[2] + t*c[3]));
+}
+
+void TabulatedFunction::setParameters(std::vector<double> params) {
+  m_Function->setParameters(params);
+  this->build();
+}
+
+//Print
+void TabulatedFunction::printInfo() {
+  std::cout << std::endl;
+  std::cout << "function: " << m_FunctionName << " (tabulated)" << std::endl;
+  std::cout << "rangeMin: " << m_RMin << std::endl;
+  std::cout << "rangeMax: " << m_RMax << std::endl;
+  std::cout << "integral: " << m_Integral << ", calculated using " << m_IntDiv << " divisions" << std::endl;
+  std::cout << "knots: " << this->nKnots() << " in " << m_NBlocks << " blocks" << std::endl;
+  std::cout << "max relative error: " << m_MaxRelError << " (estimated, target " << m_RelTol << (this->converged() ? ")" : ", NOT reached)") << std::endl;
+};
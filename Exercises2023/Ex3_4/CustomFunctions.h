@@ -4,60 +4,81 @@
  * @date 05-12-2023
  */
 
+#include <random>
 #include "FiniteFunctions.h"
+#include "StaticFunctions.h"
 
 #pragma once
 
 class NormalDistributionFunction : public FiniteFunction{
   
 public:
-  NormalDistributionFunction() : FiniteFunction() {m_mu = 0.0; m_sigma = 1.0;}; //Empty constructor
-  NormalDistributionFunction(double range_min, double range_max, std::string outfile, double mu=0.0, double sigma=1.0) : FiniteFunction(range_min, range_max, outfile) {m_mu = mu; m_sigma = sigma;}; //Variable constructor
+  NormalDistributionFunction() : FiniteFunction() {m_mu = 0.0; m_sigma = 1.0; updateDensity();}; //Empty constructor
+  NormalDistributionFunction(double range_min, double range_max, std::string outfile, double mu=0.0, double sigma=1.0) : FiniteFunction(range_min, range_max, outfile) {m_mu = mu; m_sigma = sigma; updateDensity();}; //Variable constructor
   virtual double getMean(); //Return mean value
   virtual double callFunction(double x); //Call the function with value x
+  virtual void logFunction(const double* x, double* out, int n); //Batch log f(x) for likelihood fits
+  virtual void batchFunction(const double* x, double* out, int n); //Batch f(x) for the Monte Carlo integrators
+  virtual std::vector<double> getParameters() {return {m_mu, m_sigma};};
+  virtual void setParameters(std::vector<double> params); //mu, sigma
+  virtual std::vector<std::string> getParameterNames() {return {"mu", "sigma"};};
   virtual void printInfo(); //Dump parameter info about the current function
 private:
   double m_mu;
   double m_sigma;
-  double normal(double x, double mu, double sigma);
+  NormalDensity m_Density; // Parameters plus precomputed constants, rebuilt whenever the parameters change
+  void updateDensity();
 };
 
 class CauchyLorentzDistribution : public FiniteFunction{
 
 public:
-  CauchyLorentzDistribution() : FiniteFunction() {m_x0 = 0.0; m_gamma = 1.0;}; //Empty constructor
-  CauchyLorentzDistribution(double range_min, double range_max, std::string outfile, double x0=0.0, double gamma=1.0) : FiniteFunction(range_min, range_max, outfile) {m_x0 = x0; m_gamma = gamma;}; //Variable constructor
+  CauchyLorentzDistribution() : FiniteFunction() {m_x0 = 0.0; m_gamma = 1.0; updateDensity();}; //Empty constructor
+  CauchyLorentzDistribution(double range_min, double range_max, std::string outfile, double x0=0.0, double gamma=1.0) : FiniteFunction(range_min, range_max, outfile) {m_x0 = x0; m_gamma = gamma; updateDensity();}; //Variable constructor
   virtual double getMean(); //Return mean value
   virtual double callFunction(double x); //Call the function with value x
+  virtual void logFunction(const double* x, double* out, int n); //Batch log f(x) for likelihood fits
+  virtual void batchFunction(const double* x, double* out, int n); //Batch f(x) for the Monte Carlo integrators
+  virtual std::vector<double> getParameters() {return {m_x0, m_gamma};};
+  virtual void setParameters(std::vector<double> params); //x0, gamma
+  virtual std::vector<std::string> getParameterNames() {return {"x0", "gamma"};};
   virtual void printInfo(); //Dump parameter info about the current function
 private:
   double m_x0;
   double m_gamma;
-  double cauchy(double x, double gamma);
+  CauchyLorentzDensity m_Density; // Parameters plus precomputed constants, rebuilt whenever the parameters change
+  void updateDensity();
 };
 
 class NegativeCrystalBallDistribution : public FiniteFunction{
 
 public:
-  NegativeCrystalBallDistribution() : FiniteFunction() {m_xbar = 0.0; m_sigma = 1.0; m_alpha = 1.0; m_n = 1.0;}; //Empty constructor
-  NegativeCrystalBallDistribution(double range_min, double range_max, std::string outfile, double xbar=0.0, double sigma=1.0, double alpha=1.0, double n=1.0) : FiniteFunction(range_min, range_max, outfile) {m_xbar = xbar; m_sigma = sigma; m_alpha = alpha; m_n = n;}; //Variable constructor
+  NegativeCrystalBallDistribution() : FiniteFunction() {m_xbar = 0.0; m_sigma = 1.0; m_alpha = 1.0; m_n = 1.0; updateDensity();}; //Empty constructor
+  NegativeCrystalBallDistribution(double range_min, double range_max, std::string outfile, double xbar=0.0, double sigma=1.0, double alpha=1.0, double n=1.0) : FiniteFunction(range_min, range_max, outfile) {m_xbar = xbar; m_sigma = sigma; m_alpha = alpha; m_n = n; updateDensity();}; //Variable constructor
   virtual double getMean(); //Return mean value
   virtual double callFunction(double x); //Call the function with value x
+  virtual void logFunction(const double* x, double* out, int n); //Batch log f(x) for likelihood fits
+  virtual void batchFunction(const double* x, double* out, int n); //Batch f(x) for the Monte Carlo integrators
+  virtual std::vector<double> getParameters() {return {m_xbar, m_sigma, m_alpha, m_n};};
+  virtual void setParameters(std::vector<double> params); //xbar, sigma, alpha, n
+  virtual std::vector<std::string> getParameterNames() {return {"xbar", "sigma", "alpha", "n"};};
   virtual void printInfo(); // Dump parameter info about the current function
 private:
   double m_alpha;
   double m_n;
   double m_xbar;
   double m_sigma;
-  double negativeCrystalBall(double x, double xbar, double sigma, double alpha, double n);
+  NegativeCrystalBallDensity m_Density; // A, B, N etc. precomputed, rebuilt whenever the parameters change
+  void updateDensity();
 };
 
 class MetropolisHastings : public FiniteFunction{
 
 public:
   MetropolisHastings() : FiniteFunction() {}; //Empty constructor
-  MetropolisHastings(FiniteFunction* function, int samples) : FiniteFunction() { //Variable constructor
+  MetropolisHastings(FiniteFunction* function, int samples, unsigned long seed = std::random_device{}()) : FiniteFunction() { //Variable constructor
     m_Function = function; // Set function
+    m_Gen.seed(seed); // Each sampler has its own stream, so samplers on different threads don't share state
     setRangeMin(m_Function->rangeMin()); // Unpack lower bound
     setRangeMax(m_Function->rangeMax()); // Unpack upper bound
     nSamples = samples;
@@ -71,7 +92,44 @@ private:
   FiniteFunction* m_Function;
   int nSamples;
   double m_norm_mean;
+  std::mt19937_64 m_Gen;
   double random(int min, int max); // Uniform random number
   double random_normal(double norm_sigma); // Normal sampled random number
 
 };
+
+class TabulatedFunction : public FiniteFunction{
+
+public:
+  // Tabulate function over its range with a cubic spline whose relative error at the check points is below relTol.
+  // The error is estimated on 7 points per segment, not bounded; check converged() after building.
+  // The wrapped callFunction is evaluated from several threads while building, so it must not modify the object.
+  TabulatedFunction(FiniteFunction* function, std::string outfile, double relTol = 1e-6, int nThreads = 0);
+  virtual double callFunction(double x); //O(1) spline lookup
+  virtual double getMean() {return m_Function->getMean();};
+  virtual std::vector<double> getParameters() {return m_Function->getParameters();};
+  virtual void setParameters(std::vector<double> params); //Forward to the wrapped function and rebuild the table
+  virtual std::vector<std::string> getParameterNames() {return m_Function->getParameterNames();};
+  virtual void printInfo(); //Dump table info
+  bool build(); //(Re)build the table, call after changing the wrapped function directly; false if some block missed relTol
+  bool converged() {return m_MaxRelError <= m_RelTol;}; //Every block reached relTol at its check points
+  double maxRelError() {return m_MaxRelError;}; //Worst relative error found at the check points (an estimate)
+  int nKnots() {return m_Coeffs.size()/4 + m_Blocks.size();};
+
+private:
+  struct Block { //Uniform sub-grid within one of the equal width blocks
+    double start; //x at the left edge of the block
+    double invH; //1/knot spacing
+    int offset; //First segment of this block in m_Coeffs
+    int nSeg; //Number of segments in this block
+  };
+  FiniteFunction* m_Function;
+  double m_RelTol;
+  int m_Threads;
+  int m_NBlocks = 64; //Blocks the range is split into, each refined independently
+  int m_MaxSeg = 4096; //Refinement limit per block
+  double m_InvBlock; //1/block width
+  std::vector<Block> m_Blocks;
+  std::vector<double> m_Coeffs; //4 cubic coefficients per segment in the local coordinate t in [0,1)
+  double m_MaxRelError = 0;
+};
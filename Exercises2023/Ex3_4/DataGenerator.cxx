@@ -0,0 +1,309 @@
+/**
+ * @file DataGenerator.cxx
+ * @author Kierran Falloon (kierran.falloon@strath.ac.uk)
+ * @date 05-12-2023
+ */
+
+#include <iostream>
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "DataGenerator.h"
+#include "CustomFunctions.h"
+#include "DataWriter.h"
+#include "Parallel.h"
+
+// Uniform in [0, 1) from the top 53 bits, quicker than std::uniform_real_distribution and the same resolution
+static inline double uniform01(std::mt19937_64 &gen) {
+  return (gen() >> 11)*0x1.0p-53;
+}
+
+/*
+###################
+//Samplers
+###################
+*/
+
+TruncatedNormal::TruncatedNormal(double a, double b) {
+  m_A = a;
+  m_B = b;
+  // Phi(b) - Phi(a), through whichever erfc keeps the far tails accurate
+  m_Mass = (a > 0) ? 0.5*(std::erfc(a/M_SQRT2) - std::erfc(b/M_SQRT2)) : 0.5*(std::erfc(-b/M_SQRT2) - std::erfc(-a/M_SQRT2));
+  if (m_Mass >= 0.3) {
+    m_Method = Method::Normal;
+    return;
+  }
+  if (a >= 0 || b <= 0) { // Entirely in one tail
+    m_Mirror = (b <= 0);
+    double near = m_Mirror ? -b : a, far = m_Mirror ? -a : b;
+    m_Lambda = (near + sqrt(near*near + 4))/2; // Optimal rate for the exponential proposal (Robert 1995)
+    m_PeakSq = near*near;
+    m_Method = (far - near > 1/m_Lambda) ? Method::Exponential : Method::Uniform;
+    return;
+  }
+  m_Method = Method::Uniform; // Narrow interval around 0
+  m_PeakSq = 0;
+}
+
+double TruncatedNormal::operator()(std::mt19937_64 &gen, std::normal_distribution<double> &normal) const {
+  switch (m_Method) {
+  case Method::Normal:
+    while (true) {
+      double z = normal(gen);
+      if (z >= m_A && z <= m_B) return z;
+    }
+  case Method::Exponential: {
+    double near = m_Mirror ? -m_B : m_A, far = m_Mirror ? -m_A : m_B;
+    while (true) {
+      double z = near - log(1 - uniform01(gen))/m_Lambda;
+      if (z > far) continue;
+      if (uniform01(gen) < exp(-0.5*(z - m_Lambda)*(z - m_Lambda))) return m_Mirror ? -z : z;
+    }
+  }
+  default:
+    while (true) {
+      double z = m_A + (m_B - m_A)*uniform01(gen);
+      if (uniform01(gen) < exp(0.5*(m_PeakSq - z*z))) return z;
+    }
+  }
+}
+
+NormalSampler::NormalSampler(double min, double max, double mu, double sigma) {
+  m_Mu = mu;
+  m_Sigma = sigma;
+  m_Z = TruncatedNormal((min - mu)/sigma, (max - mu)/sigma);
+}
+
+void NormalSampler::fill(double* x, long n, std::mt19937_64 &gen) const {
+  std::normal_distribution<double> normal;
+  for (long i = 0; i < n; i++) x[i] = m_Mu + m_Sigma*m_Z(gen, normal);
+}
+
+CauchySampler::CauchySampler(double min, double max, double x0, double gamma) {
+  m_X0 = x0;
+  m_Gamma = gamma;
+  m_Ulo = 0.5 + atan((min - x0)/gamma)/M_PI;
+  m_Uhi = 0.5 + atan((max - x0)/gamma)/M_PI;
+}
+
+void CauchySampler::fill(double* x, long n, std::mt19937_64 &gen) const {
+  for (long i = 0; i < n; i++) x[i] = m_X0 + m_Gamma*tan(M_PI*(m_Ulo + (m_Uhi - m_Ulo)*uniform01(gen) - 0.5));
+}
+
+// In z = (x - xbar)/sigma the tail (z <= -alpha) is A (B - z)^-n and the core exp(-z^2/2). The tail CDF goes as
+// S(z) = ((B - z)/(n/alpha))^(1-n), which is 1 at z = -alpha and keeps A's n^n out of the arithmetic.
+CrystalBallSampler::CrystalBallSampler(double min, double max, double xbar, double sigma, double alpha, double n) {
+  m_Xbar = xbar;
+  m_Sigma = sigma;
+  m_N = n;
+  alpha = std::abs(alpha);
+  m_B = n/alpha - alpha;
+  m_Scale = n/alpha; // B - z at z = -alpha
+  double za = (min - xbar)/sigma, zb = (max - xbar)/sigma;
+
+  double tail = 0, core = 0;
+  if (za < -alpha) {
+    double z2 = std::min(zb, -alpha);
+    m_Tlo = pow((m_B - za)/m_Scale, 1 - n);
+    m_Thi = pow((m_B - z2)/m_Scale, 1 - n);
+    tail = m_Scale*exp(-alpha*alpha/2)/(n - 1)*(m_Thi - m_Tlo);
+  }
+  if (zb > -alpha) {
+    m_Core = TruncatedNormal(std::max(za, -alpha), zb);
+    core = sqrt(2*M_PI)*m_Core.mass();
+  }
+  m_PTail = tail/(tail + core);
+}
+
+void CrystalBallSampler::fill(double* x, long n, std::mt19937_64 &gen) const {
+  std::normal_distribution<double> normal;
+  for (long i = 0; i < n; i++) {
+    double z;
+    if (uniform01(gen) < m_PTail) { // S(z) is uniform in the tail, invert it
+      double S = m_Tlo + uniform01(gen)*(m_Thi - m_Tlo);
+      z = m_B - m_Scale*pow(S, 1/(1 - m_N));
+    }
+    else z = m_Core(gen, normal);
+    x[i] = m_Xbar + m_Sigma*z;
+  }
+}
+
+EnvelopeSampler::EnvelopeSampler(FiniteFunction* function, int nBins, int nThreads) {
+  const int perBin = 8; // Evaluations across each bin, the edges are shared with the neighbours
+  const double margin = 1.1;
+  m_Function = function;
+  m_Min = function->rangeMin();
+  m_Width = (function->rangeMax() - m_Min)/nBins;
+
+  long nEvals = long(nBins)*(perBin - 1) + 1;
+  std::vector<double> x(nEvals), f(nEvals);
+  for (long i = 0; i < nEvals; i++) x[i] = m_Min + m_Width*i/(perBin - 1);
+  parallel_for(nEvals, [&](long begin, long end, int) {
+    m_Function->batchFunction(x.data() + begin, f.data() + begin, end - begin);
+  }, nThreads);
+  m_Bound.resize(nBins);
+  for (int b = 0; b < nBins; b++) {
+    double peak = 0; // Negative values are treated as zero density
+    for (int k = 0; k < perBin; k++) peak = std::max(peak, f[long(b)*(perBin - 1) + k]);
+    m_Bound[b] = margin*peak;
+  }
+
+  // Vose's alias method: bin b is kept with probability m_Prob[b], otherwise replaced by m_Alias[b]
+  double total = 0;
+  for (double h : m_Bound) total += h;
+  if (!(total > 0)) {
+    std::cout << "Envelope sampler: function is zero everywhere on its range, nothing to sample" << std::endl;
+    exit(1);
+  }
+  m_Prob.resize(nBins);
+  m_Alias.resize(nBins);
+  std::vector<double> scaled(nBins);
+  std::vector<int> small, large;
+  for (int b = 0; b < nBins; b++) {
+    scaled[b] = m_Bound[b]*nBins/total;
+    (scaled[b] < 1 ? small : large).push_back(b);
+  }
+  while (!small.empty() && !large.empty()) {
+    int s = small.back(), l = large.back();
+    small.pop_back();
+    m_Prob[s] = scaled[s];
+    m_Alias[s] = l;
+    scaled[l] -= 1 - scaled[s];
+    if (scaled[l] < 1) {
+      large.pop_back();
+      small.push_back(l);
+    }
+  }
+  for (int b : large) {m_Prob[b] = 1; m_Alias[b] = b;}
+  for (int b : small) {m_Prob[b] = 1; m_Alias[b] = b;} // Rounding leftovers
+}
+
+void EnvelopeSampler::fill(double* x, long n, std::mt19937_64 &gen) const {
+  const int nBatch = 256;
+  double candidates[nBatch], heights[nBatch], f[nBatch];
+  int bins[nBatch];
+  const int nBins = m_Bound.size();
+  long filled = 0, violations = 0;
+  while (filled < n) {
+    for (int i = 0; i < nBatch; i++) {
+      double u = uniform01(gen)*nBins;
+      int b = std::min(int(u), nBins - 1);
+      if (u - b >= m_Prob[b]) b = m_Alias[b];
+      bins[i] = b;
+      candidates[i] = m_Min + (b + uniform01(gen))*m_Width;
+      heights[i] = uniform01(gen)*m_Bound[b];
+    }
+    m_Function->batchFunction(candidates, f, nBatch);
+    for (int i = 0; i < nBatch && filled < n; i++) {
+      if (heights[i] >= f[i]) continue;
+      x[filled++] = candidates[i];
+      if (f[i] > m_Bound[bins[i]]) violations++;
+    }
+  }
+  if (violations) m_Violations += violations;
+}
+
+std::unique_ptr<Sampler> make_sampler(FiniteFunction* function, int nThreads) {
+  double min = function->rangeMin(), max = function->rangeMax();
+  std::vector<double> p = function->getParameters();
+  if (dynamic_cast<NormalDistributionFunction*>(function)) return std::make_unique<NormalSampler>(min, max, p[0], p[1]);
+  if (dynamic_cast<CauchyLorentzDistribution*>(function)) return std::make_unique<CauchySampler>(min, max, p[0], p[1]);
+  if (dynamic_cast<NegativeCrystalBallDistribution*>(function) && p[3] > 1) return std::make_unique<CrystalBallSampler>(min, max, p[0], p[1], p[2], p[3]);
+  return std::make_unique<EnvelopeSampler>(function, 4096, nThreads);
+}
+
+/*
+###################
+//Generation
+###################
+*/
+
+GenerateResult generate_data(FiniteFunction* function, std::string filename, std::uint64_t count, std::uint64_t seed, int nThreads, bool binary, int digits) {
+  const std::uint64_t blockSize = 1 << 16;
+  const std::uint64_t nBlocks = (count + blockSize - 1)/blockSize;
+  const int nWorkers = static_cast<int>(std::min<std::uint64_t>(thread_count(nThreads), std::max<std::uint64_t>(nBlocks, 1)));
+  const int nSlots = 2*nWorkers; // Blocks in flight: workers run at most this far ahead of the writer
+  digits = std::clamp(digits, 0, 17); // 17 significant digits already round trip any double
+  const long rowChars = (digits > 0 ? digits + 7 : 24) + 1; // Sign, point and "e-308" around the digits (shortest round trip is at most 24), then '\n'
+
+  auto start = std::chrono::steady_clock::now();
+  std::unique_ptr<Sampler> sampler = make_sampler(function, nThreads);
+  GenerateResult result;
+  result.sampler = sampler->name();
+
+  DataWriter writer(filename, binary, "", 1 << 20);
+  if (!writer.good()) return result;
+  if (binary) writer.section("data", count, 1);
+
+  // Each slot holds one finished block, slot s only ever takes blocks s, s + nSlots, ...
+  std::vector<std::vector<char>> slots(nSlots);
+  std::vector<std::uint64_t> ready(nSlots, UINT64_MAX); // Block held by each slot, UINT64_MAX for none
+  std::mutex mutex;
+  std::condition_variable filled, freed;
+  std::uint64_t written = 0; // Blocks [0, written) are in the writer
+  std::atomic<std::uint64_t> next{0};
+
+  auto worker = [&]() {
+    std::vector<double> values(blockSize);
+    std::vector<char> bytes;
+    while (true) {
+      std::uint64_t b = next.fetch_add(1);
+      if (b >= nBlocks) return;
+      long n = std::min(blockSize, count - b*blockSize);
+      std::mt19937_64 gen(stream_seed(seed, b));
+      sampler->fill(values.data(), n, gen);
+
+      if (binary) {
+        bytes.assign(reinterpret_cast<const char*>(values.data()), reinterpret_cast<const char*>(values.data() + n));
+      }
+      else {
+        bytes.resize(n*rowChars);
+        char* p = bytes.data();
+        char* end = p + bytes.size();
+        for (long i = 0; i < n; i++) {
+          std::to_chars_result r = digits > 0 ? std::to_chars(p, end - 1, values[i], std::chars_format::general, digits) : std::to_chars(p, end - 1, values[i]);
+          if (r.ec != std::errc()) {
+            std::cout << "generate_data: could not format " << values[i] << " with " << digits << " digits" << std::endl;
+            exit(1);
+          }
+          p = r.ptr;
+          *p++ = '\n';
+        }
+        bytes.resize(p - bytes.data());
+      }
+
+      std::unique_lock<std::mutex> lock(mutex);
+      freed.wait(lock, [&]() {return b < written + nSlots;}); // Wait for the slot's previous block to be written
+      slots[b % nSlots].swap(bytes);
+      ready[b % nSlots] = b;
+      filled.notify_all();
+    }
+  };
+
+  std::vector<std::thread> workers;
+  for (int t = 0; t < nWorkers; t++) workers.emplace_back(worker);
+  std::vector<char> block;
+  for (std::uint64_t b = 0; b < nBlocks; b++) {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      filled.wait(lock, [&]() {return ready[b % nSlots] == b;});
+      block.swap(slots[b % nSlots]);
+      ready[b % nSlots] = UINT64_MAX;
+      written = b + 1;
+    }
+    freed.notify_all();
+    writer.raw(block.data(), block.size()); // Outside the lock, workers keep going while this is on disk
+    result.bytes += block.size();
+  }
+  for (std::thread &w : workers) w.join();
+  writer.flush();
+
+  result.rows = count;
+  result.bytes += binary ? 8 + 32 : 0; // Magic and section header
+  result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  result.violations = sampler->violations();
+  return result;
+}
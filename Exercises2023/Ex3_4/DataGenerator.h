@@ -0,0 +1,124 @@
+/**
+ * @file DataGenerator.h
+ * @author Kierran Falloon (kierran.falloon@strath.ac.uk)
+ * @date 05-12-2023
+ */
+
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "FiniteFunctions.h"
+
+#pragma once
+
+// Draws independent samples from the normalised density of a FiniteFunction over its range.
+// fill() is const and only touches the generator it is given, so one sampler can be shared by every thread.
+class Sampler{
+
+public:
+  virtual ~Sampler() = default;
+  virtual void fill(double* x, long n, std::mt19937_64 &gen) const = 0; //n samples into x
+  virtual std::string name() const = 0; //Method used, for logging
+  virtual long violations() const {return 0;}; //Envelope sampler only: points where f was above its bound
+};
+
+// Standard normal truncated to [a, b], by whichever of plain rejection, Robert's exponential proposal (for a tail)
+// or a uniform proposal (for a narrow interval) accepts most often
+class TruncatedNormal{
+
+public:
+  TruncatedNormal(double a = -INFINITY, double b = INFINITY);
+  double operator()(std::mt19937_64 &gen, std::normal_distribution<double> &normal) const; //normal is the caller's, so it keeps its cached second value
+  double mass() const {return m_Mass;}; //Standard normal probability of [a, b]
+
+private:
+  enum class Method {Normal, Exponential, Uniform};
+  Method m_Method;
+  double m_A, m_B, m_Mass;
+  bool m_Mirror = false; //Left tail sampled as the right tail of -z
+  double m_Lambda = 0; //Exponential proposal rate
+  double m_PeakSq = 0; //Uniform proposal: z^2 at the point of [a, b] nearest 0
+};
+
+class NormalSampler : public Sampler{
+
+public:
+  NormalSampler(double min, double max, double mu, double sigma);
+  virtual void fill(double* x, long n, std::mt19937_64 &gen) const;
+  virtual std::string name() const {return "truncated normal";};
+
+private:
+  double m_Mu, m_Sigma;
+  TruncatedNormal m_Z;
+};
+
+// Inverse CDF restricted to the range, every draw is used
+class CauchySampler : public Sampler{
+
+public:
+  CauchySampler(double min, double max, double x0, double gamma);
+  virtual void fill(double* x, long n, std::mt19937_64 &gen) const;
+  virtual std::string name() const {return "Cauchy-Lorentz inverse CDF";};
+
+private:
+  double m_X0, m_Gamma;
+  double m_Ulo, m_Uhi; //CDF at the range ends
+};
+
+// Picks the power-law tail or the Gaussian core by their integrals over the range, then samples the tail by its
+// inverse CDF and the core as a truncated normal. Needs n > 1.
+class CrystalBallSampler : public Sampler{
+
+public:
+  CrystalBallSampler(double min, double max, double xbar, double sigma, double alpha, double n);
+  virtual void fill(double* x, long n, std::mt19937_64 &gen) const;
+  virtual std::string name() const {return "Crystal Ball tail inverse CDF + truncated normal core";};
+
+private:
+  double m_Xbar, m_Sigma, m_N, m_B;
+  double m_PTail; //Probability of the tail part
+  double m_Scale; //n/alpha, B-z at the tail edge
+  double m_Tlo, m_Thi; //((B-z)/scale)^(1-n) at the ends of the tail part
+  TruncatedNormal m_Core;
+};
+
+// Any FiniteFunction: rejection from a piecewise constant envelope over nBins bins, bins picked with an alias table
+// and candidates evaluated nBatch at a time with batchFunction. Each bound is the largest of several evaluations
+// across its bin plus a margin, so f is assumed smooth on the bin scale; points where f turns out to be above the
+// bound are counted in violations().
+class EnvelopeSampler : public Sampler{
+
+public:
+  EnvelopeSampler(FiniteFunction* function, int nBins = 4096, int nThreads = 0);
+  virtual void fill(double* x, long n, std::mt19937_64 &gen) const;
+  virtual std::string name() const {return "piecewise constant envelope rejection";};
+  virtual long violations() const {return m_Violations;};
+
+private:
+  FiniteFunction* m_Function;
+  double m_Min, m_Width; //Range start and bin width
+  std::vector<double> m_Bound; //Envelope height per bin
+  std::vector<double> m_Prob; //Alias table
+  std::vector<int> m_Alias;
+  mutable std::atomic<long> m_Violations{0};
+};
+
+std::unique_ptr<Sampler> make_sampler(FiniteFunction* function, int nThreads = 0); //Exact sampler for the CustomFunctions distributions, envelope rejection for anything else
+
+struct GenerateResult {
+  std::uint64_t rows = 0;
+  std::uint64_t bytes = 0; //Written to the file
+  double seconds = 0;
+  std::string sampler;
+  long violations = 0;
+};
+
+// Write count samples of function to filename, one value per line (digits significant figures up to 17, 0 for
+// shortest round trip) or in the DataWriter binary layout (one "data" section, count rows, 1 column).
+// Blocks of 65536 samples are drawn and formatted on nThreads workers, each block from its own generator seeded by
+// (seed, block), and written in order by the calling thread, so the file only depends on the seed.
+GenerateResult generate_data(FiniteFunction* function, std::string filename, std::uint64_t count, std::uint64_t seed = 1, int nThreads = 0, bool binary = false, int digits = 6);
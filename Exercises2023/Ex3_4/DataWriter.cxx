@@ -0,0 +1,89 @@
+/**
+ * @file DataWriter.cxx
+ * @author Kierran Falloon (kierran.falloon@strath.ac.uk)
+ * @date 05-12-2023
+ */
+
+#include <iostream>
+#include <charconv>
+#include <cstring>
+#include <algorithm>
+#include "DataWriter.h"
+
+DataWriter::DataWriter(std::string filename, bool binary, std::string header, std::size_t bufferSize){
+  m_Binary = binary;
+  m_Buffer.resize(bufferSize);
+  m_File = std::fopen(filename.c_str(), binary ? "wb" : "w");
+  if (m_File == nullptr){
+    std::cout << "Could not open file " + filename + " for writing" << std::endl;
+    return;
+  }
+  if (binary) this->put("FFDATA01", 8);
+  else if (!header.empty()) this->text(header);
+}
+
+DataWriter::~DataWriter(){
+  if (m_File == nullptr) return;
+  this->flush();
+  std::fclose(m_File);
+}
+
+void DataWriter::section(std::string name, std::uint64_t rows, std::uint64_t columns){
+  m_Section = name;
+  if (!m_Binary || m_File == nullptr) return;
+  char padded[16] = {0};
+  std::memcpy(padded, name.data(), std::min<std::size_t>(name.size(), 16));
+  this->put(padded, 16);
+  this->put(reinterpret_cast<const char*>(&rows), sizeof(rows));
+  this->put(reinterpret_cast<const char*>(&columns), sizeof(columns));
+}
+
+void DataWriter::row(const double* values, int n){
+  if (m_File == nullptr) return;
+  if (m_Binary){
+    this->put(reinterpret_cast<const char*>(values), n*sizeof(double));
+    return;
+  }
+  char line[32*8 + 64]; //Shortest round-trip doubles are at most 24 characters
+  char* p = line;
+  char* end = line + sizeof(line);
+  if (!m_Section.empty()){
+    std::size_t len = std::min<std::size_t>(m_Section.size(), 32);
+    std::memcpy(p, m_Section.data(), len);
+    p += len;
+    *p++ = ',';
+  }
+  for (int i = 0; i < n; i++){
+    if (end - p < 32){ //Very wide rows go out in pieces
+      this->put(line, p - line);
+      p = line;
+    }
+    if (i) *p++ = ',';
+    p = std::to_chars(p, end, values[i]).ptr;
+  }
+  *p++ = '\n';
+  this->put(line, p - line);
+}
+
+void DataWriter::text(std::string line){
+  if (m_Binary || m_File == nullptr) return;
+  this->put(line.data(), line.size());
+  this->put("\n", 1);
+}
+
+void DataWriter::flush(){
+  if (m_File == nullptr || m_Used == 0) return;
+  std::fwrite(m_Buffer.data(), 1, m_Used, m_File);
+  m_Used = 0;
+}
+
+//Copy into the buffer, going straight to the file for anything bigger than the buffer
+void DataWriter::put(const char* bytes, std::size_t n){
+  if (m_Used + n > m_Buffer.size()) this->flush();
+  if (n > m_Buffer.size()){
+    std::fwrite(bytes, 1, n, m_File);
+    return;
+  }
+  std::memcpy(m_Buffer.data() + m_Used, bytes, n);
+  m_Used += n;
+}
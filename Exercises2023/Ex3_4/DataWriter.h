@@ -0,0 +1,40 @@
+/**
+ * @file DataWriter.h
+ * @author Kierran Falloon (kierran.falloon@strath.ac.uk)
+ * @date 05-12-2023
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#pragma once
+
+// Buffered writer for numeric tables, either CSV (numbers formatted with std::to_chars) or a compact binary layout.
+// Rows go through a fixed size buffer straight to the file, so nothing is held in memory beyond that buffer.
+//
+// Binary layout: the 8 byte magic "FFDATA01", then for each section a 16 byte zero padded name, a uint64 row count,
+// a uint64 column count, and rows*columns native doubles.
+// CSV layout: an optional header line, then one line per row, prefixed with the section name if one is set.
+class DataWriter{
+
+public:
+  DataWriter(std::string filename, bool binary = false, std::string header = "", std::size_t bufferSize = 1 << 16);
+  ~DataWriter(); //Flushes and closes the file
+  bool good() {return m_File != nullptr;}; //False if the file couldn't be opened
+  void section(std::string name, std::uint64_t rows, std::uint64_t columns); //Start a block of rows (rows/columns only used by the binary layout)
+  void row(const double* values, int n); //Write one row of n values
+  void row(double x, double y) {double values[2] = {x, y}; this->row(values, 2);};
+  void text(std::string line); //Raw line (CSV only, ignored for binary)
+  void raw(const char* bytes, std::size_t n) {if (m_File != nullptr) this->put(bytes, n);}; //Bytes already laid out by the caller (e.g. blocks formatted on other threads)
+  void flush();
+
+private:
+  std::FILE* m_File;
+  bool m_Binary;
+  std::string m_Section; //CSV prefix for the current block
+  std::vector<char> m_Buffer;
+  std::size_t m_Used = 0;
+  void put(const char* bytes, std::size_t n);
+};
@@ -1,10 +1,16 @@
 #include <iostream>
+#include <fstream>
 #include <string>
 #include <vector>
 #include "FiniteFunctions.h"
 #include <filesystem> //To check extensions in a nice way
+#include <cmath>
+#include <algorithm>
 
-#include "gnuplot-iostream.h" //Needed to produce plots (not part of the course) 
+#include "PlotQueue.h" //Plots are handed to a background worker
+#include "DataWriter.h"
+#include "QuantileSketch.h"
+#include "KernelDensity.h"
 
 using std::filesystem::path;
 
@@ -24,11 +30,12 @@ FiniteFunction::FiniteFunction(double range_min, double range_max, std::string o
   this->checkPath(outfile); //Use provided string to name output files
 }
 
-//Plots are called in the destructor
-//SUPACPP note: They syntax of the plotting code is not part of the course
+//Plots are queued in the destructor (unless render() was already called) and drawn by the PlotQueue worker thread
 FiniteFunction::~FiniteFunction(){
-  Gnuplot gp; //Set up gnuplot object
-  this->generatePlot(gp); //Generate the plot and save it to a png using "outfile" for naming 
+  if (!m_rendered) this->render();
+#ifdef FF_STATS
+  if (!m_Stats.empty()) this->exportStats();
+#endif
 }
 
 /*
@@ -39,6 +46,7 @@ FiniteFunction::~FiniteFunction(){
 void FiniteFunction::setRangeMin(double RMin) {m_RMin = RMin;};
 void FiniteFunction::setRangeMax(double RMax) {m_RMax = RMax;};
 void FiniteFunction::setOutfile(std::string Outfile) {this->checkPath(Outfile);};
+void FiniteFunction::setPlotRange(double min, double max) {m_PlotMin = min; m_PlotMax = max;};
 
 /*
 ###################
@@ -54,7 +62,18 @@ double FiniteFunction::rangeMax() {return m_RMax;};
 ###################
 */ 
 double FiniteFunction::invxsquared(double x) {return 1/(1+x*x);};
-double FiniteFunction::callFunction(double x) {return this->invxsquared(x);}; //(overridable)
+double FiniteFunction::callFunction(double x) {FF_STAT_ADD(m_Stats, calls, 1); return this->invxsquared(x);}; //(overridable)
+
+//Batch log evaluation (overridable), the default just loops over callFunction
+void FiniteFunction::logFunction(const double* x, double* out, int n){
+  FF_STAT_ADD(m_Stats, logEvals, n);
+  for (int i = 0; i < n; i++) out[i] = log(this->callFunction(x[i]));
+}
+
+//Batch evaluation (overridable), the default just loops over callFunction
+void FiniteFunction::batchFunction(const double* x, double* out, int n){
+  for (int i = 0; i < n; i++) out[i] = this->callFunction(x[i]);
+}
 
 /*
 ###################
@@ -62,9 +81,12 @@ Integration by hand using Simpson's rule
 ###################
 */
 double FiniteFunction::integrate(int Ndiv){ // private
+  FF_STAT_TIMER(m_Stats, integrateNs);
+  FF_STAT_ADD(m_Stats, integrations, 1);
+  FF_STAT_ADD(m_Stats, integrationEvals, Ndiv+1);
   double h = (m_RMax - m_RMin)/Ndiv; // determine x steps from overall range and number of divisions
   double integral = 0; // initialise integral as 0
-  double S_zero, S_one, S_two; // Simpson's rule: I = h/3*(S0 + 4S1 + 2S2)
+  double S_zero = 0, S_one = 0, S_two = 0; // Simpson's rule: I = h/3*(S0 + 4S1 + 2S2)
 
   for (int n = 0; n <= Ndiv; n++){ // loop over divisions
     double x = m_RMin + n*h; // x value
@@ -81,6 +103,33 @@ double FiniteFunction::integrate(int Ndiv){ // private
   integral = (h/3) * (S_zero + 4*S_one + 2*S_two);
   return integral; // sum of parabolic areas approximating integral. large Ndiv = decreased error.
 }
+//Map the unit interval onto the range and let qmc_integrate grow the sample until the tolerance is met
+double FiniteFunction::integrateMC(){ // private
+  FF_STAT_TIMER(m_Stats, integrateNs);
+  const double width = m_RMax - m_RMin;
+  Sequence sequence = (m_Integrator == Integrator::Sobol) ? Sequence::Sobol : (m_Integrator == Integrator::Halton) ? Sequence::Halton : Sequence::MonteCarlo;
+  QMCResult result = qmc_integrate([this, width](const double* u, int n, double* out){
+    double x[1024];
+    for (int start = 0; start < n; start += 1024){
+      int m = std::min(1024, n - start);
+      for (int i = 0; i < m; i++) x[i] = m_RMin + u[start + i]*width;
+      this->batchFunction(x, out + start, m);
+    }
+  }, 1, m_IntTolerance, sequence);
+  FF_STAT_ADD(m_Stats, integrations, 1);
+  FF_STAT_ADD(m_Stats, integrationEvals, result.nPoints*result.nReplicates);
+  if (!result.converged) std::cout << m_FunctionName << ": Monte Carlo integral didn't reach relative error " << m_IntTolerance << ", got " << result.error/std::abs(result.value) << std::endl;
+  m_IntError = result.error*width;
+  return result.value*width;
+}
+
+void FiniteFunction::setIntegrator(Integrator method, double tolerance){
+  m_Integrator = method;
+  m_IntTolerance = tolerance;
+  m_IntError = 0;
+  m_Integral = NULL; //Recalculate with the new backend
+}
+
 double FiniteFunction::integral(int Ndiv) { //public
   if (Ndiv <= 0){
     std::cout << "Invalid number of divisions for integral, setting Ndiv to 1000" <<std::endl;
@@ -88,10 +137,11 @@ double FiniteFunction::integral(int Ndiv) { //public
   }
   if (m_Integral == NULL || Ndiv != m_IntDiv){
     m_IntDiv = Ndiv;
-    m_Integral = this->integrate(Ndiv);
+    m_Integral = (m_Integrator == Integrator::Simpson) ? this->integrate(Ndiv) : this->integrateMC();
     return m_Integral;
   }
-  else return m_Integral; //Don't bother re-calculating integral if Ndiv is the same as the last call
+  FF_STAT_ADD(m_Stats, integralCacheHits, 1);
+  return m_Integral; //Don't bother re-calculating integral if Ndiv is the same as the last call
 }
 
 /*
@@ -103,7 +153,7 @@ double FiniteFunction::integral(int Ndiv) { //public
 void FiniteFunction::checkPath(std::string outfile){
  path fp = outfile;
  m_FunctionName = fp.stem(); 
- m_OutData = m_FunctionName+".data";
+ m_OutData = "Outputs/data/"+m_FunctionName+".data"; //Next to the plots in Outputs/png
  m_OutPng = m_FunctionName+".png";
 }
 
@@ -130,6 +180,7 @@ void FiniteFunction::plotFunction(){
 //Transform data points into a format gnuplot can use (histogram) and set flag to enable drawing of data to output plot
 //set isdata to true (default) to plot data points in black, set to false to plot sample points in blue
 void FiniteFunction::plotData(std::vector<double> &points, int Nbins, bool isdata){
+  if (Nbins <= 0) Nbins = fd_bins(sketch_data(points), this->plotMin(), this->plotMax()); //Bin width from the interquartile range
   if (isdata){
     m_data = this->makeHist(points,Nbins);
     m_plotdatapoints = true;
@@ -141,6 +192,64 @@ void FiniteFunction::plotData(std::vector<double> &points, int Nbins, bool isdat
 }
 
 
+//Stream whichever of the scan, data histogram and sample histogram have been filled to m_OutData, no gnuplot needed
+void FiniteFunction::exportData(bool binary){
+  DataWriter writer(m_OutData, binary, "series,x,y");
+  if (!writer.good()) return;
+  auto write = [&writer](std::string name, std::vector< std::pair<double,double> > &points){
+    writer.section(name, points.size(), 2);
+    for (auto &point : points) writer.row(point.first, point.second);
+  };
+  if (m_plotfunction) write("function", m_function_scan);
+  if (m_plotdatapoints) write("data", m_data);
+  if (m_plotsamplepoints) write("samples", m_samples);
+  if (m_plotkde) write("kde", m_kde);
+}
+
+//Counters as JSON, only the function name when the counters aren't compiled in
+std::string FiniteFunction::statsJSON(){
+#ifdef FF_STATS
+  return m_Stats.json(m_FunctionName);
+#else
+  return "{\n  \"function\": \"" + m_FunctionName + "\",\n  \"stats\": null\n}\n";
+#endif
+}
+
+void FiniteFunction::exportStats(std::string filename){
+  if (filename.empty()) filename = "Outputs/data/" + m_FunctionName + ".stats.json";
+  std::ofstream out(filename);
+  if (!out.is_open()){
+    std::cout << "Could not open file " + filename + " for writing" << std::endl;
+    return;
+  }
+  out << this->statsJSON();
+}
+
+//Snapshot everything needed for the plot and queue it, the analysis carries on while gnuplot runs
+void FiniteFunction::render(){
+  m_rendered = true;
+  if (!m_plotfunction && !m_plotdatapoints && !m_plotsamplepoints && !m_plotkde) return; //Nothing to draw
+  PlotJob job;
+  job.name = m_FunctionName;
+  job.rmin = this->plotMin();
+  job.rmax = this->plotMax();
+  job.function_scan = lttb(m_function_scan, plot_points); //Only as many points as the png can show
+  job.samples = lttb(m_samples, plot_points);
+  job.data = lttb(m_data, plot_points);
+  job.kde = lttb(m_kde, plot_points);
+  job.plotfunction = m_plotfunction;
+  job.plotdatapoints = m_plotdatapoints;
+  job.plotsamplepoints = m_plotsamplepoints;
+  job.plotkde = m_plotkde;
+  PlotQueue::instance().push(std::move(job));
+}
+
+//Binned FFT kernel density estimate over the plot window, for a smooth comparison with the function scan
+void FiniteFunction::plotKDE(std::vector<double> &points, int gridSize){
+  m_kde = kde(points, this->plotMin(), this->plotMax(), gridSize);
+  m_plotkde = true;
+}
+
 /*
   #######################################################################################################
   ## SUPACPP Note:
@@ -150,11 +259,14 @@ void FiniteFunction::plotData(std::vector<double> &points, int Nbins, bool isdat
   #######################################################################################################
  */
 
-//Scan over range of function using range/Nscan steps (just a hack so we can plot the function)
+//Scan over the plot window using window/Nscan steps (just a hack so we can plot the function), normalised over the function range
 std::vector< std::pair<double,double> > FiniteFunction::scanFunction(int Nscan){
+  FF_STAT_TIMER(m_Stats, scanNs);
+  FF_STAT_ADD(m_Stats, scans, 1);
+  FF_STAT_ADD(m_Stats, scanPoints, Nscan);
   std::vector< std::pair<double,double> > function_scan;
-  double step = (m_RMax - m_RMin)/(double)Nscan;
-  double x = m_RMin;
+  double step = (this->plotMax() - this->plotMin())/(double)Nscan;
+  double x = this->plotMin();
   //We use the integral to normalise the function points
   if (m_Integral == NULL) {
     std::cout << "Integral not set, doing it now" << std::endl;
@@ -169,85 +281,40 @@ std::vector< std::pair<double,double> > FiniteFunction::scanFunction(int Nscan){
   return function_scan;
 }
 
-//Function to make histogram out of sampled x-values - use for input data and sampling
-std::vector< std::pair<double,double> > FiniteFunction::makeHist(std::vector<double> &points, int Nbins){
+//Count the points falling in each of Nbins equal width bins across the range, points outside the range are dropped
+std::vector<double> FiniteFunction::binData(std::vector<double> &points, int Nbins){
+  return this->binData(points, Nbins, m_RMin, m_RMax);
+}
 
-  std::vector< std::pair<double,double> > histdata; //Plottable output shape: (midpoint,frequency)
-  std::vector<int> bins(Nbins,0); //vector of Nbins ints with default value 0 
-  int norm = 0;
+std::vector<double> FiniteFunction::binData(std::vector<double> &points, int Nbins, double min, double max){
+  FF_STAT_TIMER(m_Stats, histogramNs);
+  FF_STAT_ADD(m_Stats, histograms, 1);
+  std::vector<double> bins(Nbins,0); //vector of Nbins counts with default value 0
   for (double point : points){
     //Get bin index (starting from 0) the point falls into using point value, range, and Nbins
-    int bindex = static_cast<int>(floor((point-m_RMin)/((m_RMax-m_RMin)/(double)Nbins)));
-    if (bindex<0 || bindex>Nbins){
+    int bindex = static_cast<int>(floor((point-min)/((max-min)/(double)Nbins)));
+    if (bindex<0 || bindex>=Nbins){
       continue;
     }
     bins[bindex]++; //weight of 1 for each data point
-    norm++; //Total number of data points
+    FF_STAT_ADD(m_Stats, histogramFills, 1);
   }
-  double binwidth = (m_RMax-m_RMin)/(double)Nbins;
+  return bins;
+}
+
+//Function to make histogram out of sampled x-values - use for input data and sampling
+std::vector< std::pair<double,double> > FiniteFunction::makeHist(std::vector<double> &points, int Nbins){
+
+  std::vector< std::pair<double,double> > histdata; //Plottable output shape: (midpoint,frequency)
+  double min = this->plotMin(), max = this->plotMax();
+  std::vector<double> bins = this->binData(points, Nbins, min, max);
+  double norm = 0;
+  for (double point : points) norm += (point >= m_RMin && point < m_RMax); //Points in the function range, which the scan is normalised over
+  double binwidth = (max-min)/(double)Nbins;
   for (int i=0; i<Nbins; i++){
-    double midpoint = m_RMin + i*binwidth + binwidth/2; //Just put markers at the midpoint rather than drawing bars
+    double midpoint = min + i*binwidth + binwidth/2; //Just put markers at the midpoint rather than drawing bars
     double normdata = bins[i]/((double)norm*binwidth); //Normalise with N = 1/(Ndata*binwidth)
     histdata.push_back(std::make_pair(midpoint,normdata));
   }
   return histdata;
 }
-
-//Function which handles generating the gnuplot output, called in destructor
-//If an m_plot... flag is set, the we must have filled the related data vector
-//SUPACPP note: They syntax of the plotting code is not part of the course
-void FiniteFunction::generatePlot(Gnuplot &gp){
-
-  if (m_plotfunction==true && m_plotdatapoints==true && m_plotsamplepoints==true){
-    gp << "set terminal pngcairo\n";
-    gp << "set output 'Outputs/png/"<<m_FunctionName<<".png'\n"; 
-    gp << "set xrange ["<<m_RMin<<":"<<m_RMax<<"]\n";
-    gp << "set style line 1 lt 1 lw 2 pi 1 ps 0\n";
-    gp << "plot '-' with linespoints ls 1 title '"<<m_FunctionName<<"', '-' with points ps 2 lc rgb 'blue' title 'sampled data', '-' with points ps 1 lc rgb 'black' pt 7 title 'data'\n";
-    gp.send1d(m_function_scan);
-    gp.send1d(m_samples);
-    gp.send1d(m_data);
-  }
-  else if (m_plotfunction==true && m_plotdatapoints==true){
-    gp << "set terminal pngcairo\n";
-    gp << "set output 'Outputs/png/"<<m_FunctionName<<".png'\n"; 
-    gp << "set xrange ["<<m_RMin<<":"<<m_RMax<<"]\n";
-    gp << "set style line 1 lt 1 lw 2 pi 1 ps 0\n";
-    gp << "plot '-' with linespoints ls 1 title '"<<m_FunctionName<<"', '-' with points ps 1 lc rgb 'black' pt 7 title 'data'\n";
-    gp.send1d(m_function_scan);
-    gp.send1d(m_data);
-  }
-  else if (m_plotfunction==true && m_plotsamplepoints==true){
-    gp << "set terminal pngcairo\n";
-    gp << "set output 'Outputs/png/"<<m_FunctionName<<".png'\n"; 
-    gp << "set xrange ["<<m_RMin<<":"<<m_RMax<<"]\n";
-    gp << "set style line 1 lt 1 lw 2 pi 1 ps 0\n";
-    gp << "plot '-' with linespoints ls 1 title '"<<m_FunctionName<<"', '-' with points ps 2 lc rgb 'blue' title 'sampled data'\n";
-    gp.send1d(m_function_scan);
-    gp.send1d(m_samples);
-  }
-  else if (m_plotfunction==true){
-    gp << "set terminal pngcairo\n";
-    gp << "set output 'Outputs/png/"<<m_FunctionName<<".png'\n"; 
-    gp << "set xrange ["<<m_RMin<<":"<<m_RMax<<"]\n";
-    gp << "set style line 1 lt 1 lw 2 pi 1 ps 0\n";
-    gp << "plot '-' with linespoints ls 1 title 'function'\n";
-    gp.send1d(m_function_scan);
-  }
-
-  else if (m_plotdatapoints == true){
-    gp << "set terminal pngcairo\n";
-    gp << "set output 'Outputs/png/"<<m_FunctionName<<".png'\n"; 
-    gp << "set xrange ["<<m_RMin<<":"<<m_RMax<<"]\n";
-    gp << "plot '-' with points ps 1 lc rgb 'black' pt 7 title 'data'\n";
-    gp.send1d(m_data);
-  }
-
-  else if (m_plotsamplepoints == true){
-    gp << "set terminal pngcairo\n";
-    gp << "set output 'Outputs/png/"<<m_FunctionName<<".png'\n"; 
-    gp << "set xrange ["<<m_RMin<<":"<<m_RMax<<"]\n";
-    gp << "plot '-' with points ps 2 lc rgb 'blue' title 'sampled data'\n";
-    gp.send1d(m_samples);
-  }
-}
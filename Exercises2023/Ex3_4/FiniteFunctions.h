@@ -1,36 +1,62 @@
+#include <cmath>
 #include <string>
 #include <vector>
-#include "gnuplot-iostream.h"
+#include "Stats.h"
+#include "QuasiMonteCarlo.h"
 
 #pragma once //Replacement for IFNDEF
 
+enum class Integrator {Simpson, MonteCarlo, Sobol, Halton}; //Backends for FiniteFunction::integral
+
 class FiniteFunction{
 
 public:
   FiniteFunction(); //Empty constructor
   FiniteFunction(double range_min, double range_max, std::string outfile); //Variable constructor
-  ~FiniteFunction(); //Destructor
+  virtual ~FiniteFunction(); //Destructor (virtual, the drivers own models through FiniteFunction pointers)
   double rangeMin(); //Low end of the range the function is defined within
   double rangeMax(); //High end of the range the function is defined within
   double integral(int Ndiv = 1000); 
+  void setIntegrator(Integrator method, double tolerance = 1e-6); //Simpson with Ndiv divisions (default), or (quasi-)Monte Carlo run until the relative error is below tolerance
+  double integralError() {return m_IntError;}; //Randomised QMC standard error of the last integral, 0 for Simpson
   std::vector< std::pair<double,double> > scanFunction(int Nscan = 1000); //Scan over function to plot it (slight hack needed to plot function in gnuplot)
   void setRangeMin(double RMin);
   void setRangeMax(double RMax);
   void setOutfile(std::string outfile);
+  void setPlotRange(double min, double max); //Window for the plots and histograms only, fits and integrals keep the function range
   void plotFunction(); //Plot the function using scanFunction
+  void exportData(bool binary = false); //Write the function scan, histograms and KDE to m_OutData as CSV (series,x,y) or binary (see DataWriter.h)
+  void render(); //Queue the plot now rather than at destruction (later plot calls are then not drawn)
+  std::string statsJSON(); //Runtime counters as JSON (see Stats.h), just the name when built without FF_STATS
+  void exportStats(std::string filename = ""); //Write statsJSON() to filename, default Outputs/data/<name>.stats.json (FF_STATS builds also do this on destruction)
+#ifdef FF_STATS
+  FunctionStats &stats() {return m_Stats;}; //Lets samplers and wrappers count against this function
+#endif
   virtual double getMean() {return 0;}; // Added for Metropolis Sampling Graphs.
   
   //Plot the supplied data points (either provided data or points sampled from function) as a histogram using NBins
-  void plotData(std::vector<double> &points, int NBins, bool isdata=true); //NB! use isdata flag to pick between data and sampled distributions
+  void plotData(std::vector<double> &points, int NBins, bool isdata=true); //NB! use isdata flag to pick between data and sampled distributions, NBins <= 0 picks the bin count with Freedman-Diaconis
+  void plotKDE(std::vector<double> &points, int gridSize = 1024); //Smooth kernel density estimate of the points (see KernelDensity.h), drawn as a red line
+  std::vector<double> binData(std::vector<double> &points, int Nbins); //Raw counts in Nbins equal bins over the range (what makeHist plots), for binned fits
   virtual void printInfo(); //Dump parameter info about the current function (Overridable)
   virtual double callFunction(double x); //Call the function with value x (Overridable)
+  virtual void logFunction(const double* x, double* out, int n); //Evaluate log f(x) for n points at once, used by the likelihood fitters (Overridable)
+  virtual void batchFunction(const double* x, double* out, int n); //Evaluate f(x) for n points at once, used by the Monte Carlo integrators (Overridable)
+  virtual std::vector<double> getParameters() {return {};}; //Shape parameters in a fixed order, used by the fitters (Overridable)
+  virtual void setParameters(std::vector<double> /*params*/) {}; //Set shape parameters in getParameters() order (Overridable)
+  virtual std::vector<std::string> getParameterNames() {return {};}; //Parameter names in getParameters() order (Overridable)
 
   //Protected members can be accessed by child classes but not users
 protected:
   double m_RMin;
   double m_RMax;
+  double m_PlotMin = NAN; //Plot window, the function range while unset
+  double m_PlotMax = NAN;
   double m_Integral;
   int m_IntDiv = 0; //Number of division for performing integral
+  Integrator m_Integrator = Integrator::Simpson;
+  double m_IntTolerance = 1e-6; //Relative tolerance for the Monte Carlo integrators
+  double m_IntError = 0; //Error estimate of m_Integral
   std::string m_FunctionName;
   std::string m_OutData; //Output filename for data
   std::string m_OutPng; //Output filename for plot
@@ -40,10 +66,19 @@ protected:
   bool m_plotfunction = false; //Flag to determine whether to plot function
   bool m_plotdatapoints = false; //Flag to determine whether to plot input data
   bool m_plotsamplepoints = false; //Flag to determine whether to plot sampled data 
+  std::vector< std::pair<double,double> > m_kde; //holder for the kernel density estimate
+  bool m_plotkde = false; //Flag to determine whether to plot the kernel density estimate
+  bool m_rendered = false; //Flag set once the plot has been queued
+#ifdef FF_STATS
+  FunctionStats m_Stats; //Runtime counters, only present in FF_STATS builds
+#endif
   double integrate(int Ndiv);
-  std::vector< std::pair<double, double> > makeHist(std::vector<double> &points, int Nbins); //Helper function to turn data points into histogram with Nbins
+  double integrateMC(); //Integral with the m_Integrator sequence, sets m_IntError
+  std::vector< std::pair<double, double> > makeHist(std::vector<double> &points, int Nbins); //Helper function to turn data points into histogram with Nbins over the plot window
+  std::vector<double> binData(std::vector<double> &points, int Nbins, double min, double max); //Counts in Nbins equal bins over [min, max]
+  double plotMin() {return std::isnan(m_PlotMin) ? m_RMin : m_PlotMin;};
+  double plotMax() {return std::isnan(m_PlotMax) ? m_RMax : m_PlotMax;};
   void checkPath(std::string outstring); //Helper function to ensure data and png paths are correct
-  void generatePlot(Gnuplot &gp); 
   
 private:
   double invxsquared(double x); //The default functional form
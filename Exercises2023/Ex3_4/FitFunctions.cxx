@@ -0,0 +1,259 @@
+/**
+ * @file FitFunctions.cxx
+ * @author Kierran Falloon (kierran.falloon@strath.ac.uk)
+ * @date 05-12-2023
+ */
+
+#include <iostream>
+#include <algorithm>
+#include <numeric>
+#include <limits>
+#include <cmath>
+#include "FitFunctions.h"
+#include "Parallel.h"
+
+/*
+###################
+//Minimisation
+###################
+*/
+
+// Nelder-Mead downhill simplex, see minimise_with in FitFunctions.h
+std::vector<double> minimise(const Objective &f, std::vector<double> start, std::vector<double> steps, int &nCalls, bool &converged, double tolerance, int maxCalls) {
+  SimplexScratch scratch;
+  std::vector<double> best;
+  minimise_with(f, start, steps, best, scratch, nCalls, converged, tolerance, maxCalls);
+  return best;
+}
+
+// Central difference Hessian, step sizes scale with the parameter values
+std::vector<std::vector<double>> hessian(const Objective &f, std::vector<double> point, int &nCalls) {
+  const int n = point.size();
+  std::vector<std::vector<double>> H(n, std::vector<double>(n, 0.0));
+  std::vector<double> h(n);
+  for (int i = 0; i < n; i++) h[i] = 1e-3 * std::max(std::abs(point[i]), 0.1);
+
+  double f0 = f(point); nCalls++;
+  auto shifted = [&](int i, double si, int j, double sj) {
+    std::vector<double> p = point;
+    p[i] += si*h[i];
+    p[j] += sj*h[j];
+    nCalls++;
+    return f(p);
+  };
+
+  for (int i = 0; i < n; i++) {
+    H[i][i] = (shifted(i, 1, i, 0) - 2*f0 + shifted(i, -1, i, 0)) / (h[i]*h[i]);
+    for (int j = 0; j < i; j++) {
+      H[i][j] = (shifted(i, 1, j, 1) - shifted(i, 1, j, -1) - shifted(i, -1, j, 1) + shifted(i, -1, j, -1)) / (4*h[i]*h[j]);
+      H[j][i] = H[i][j];
+    }
+  }
+  f(point); nCalls++; // Restore state held by f
+  return H;
+}
+
+// Cholesky factorisation without keeping the factor, fails on the first non-positive pivot
+static bool positive_definite(std::vector<std::vector<double>> H) {
+  const int n = H.size();
+  for (int j = 0; j < n; j++) {
+    for (int k = 0; k < j; k++) H[j][j] -= H[j][k]*H[j][k];
+    if (!(H[j][j] > 0)) return false; // Also catches NaN from a failed evaluation
+    H[j][j] = sqrt(H[j][j]);
+    for (int i = j+1; i < n; i++) {
+      for (int k = 0; k < j; k++) H[i][j] -= H[i][k]*H[j][k];
+      H[i][j] /= H[j][j];
+    }
+  }
+  return true;
+}
+
+// Invert the Hessian by Gauss-Jordan elimination, covariance = 2*errorDef*H^-1
+std::vector<double> hessian_errors(std::vector<std::vector<double>> H, double errorDef, bool &valid) {
+  const int n = H.size();
+  valid = positive_definite(H); // Not at a minimum (or flat in some direction), so there are no parabolic errors
+  if (!valid) return std::vector<double>(n, std::numeric_limits<double>::quiet_NaN());
+  std::vector<std::vector<double>> inv(n, std::vector<double>(n, 0.0));
+  for (int i = 0; i < n; i++) inv[i][i] = 1.0;
+
+  for (int col = 0; col < n; col++) {
+    int pivot = col;
+    for (int row = col+1; row < n; row++) {
+      if (std::abs(H[row][col]) > std::abs(H[pivot][col])) pivot = row;
+    }
+    if (H[pivot][col] == 0) { // Singular, can't happen once H passed the Cholesky check but kept as a guard
+      valid = false;
+      return std::vector<double>(n, std::numeric_limits<double>::quiet_NaN());
+    }
+    std::swap(H[col], H[pivot]);
+    std::swap(inv[col], inv[pivot]);
+    double scale = 1/H[col][col];
+    for (int k = 0; k < n; k++) {H[col][k] *= scale; inv[col][k] *= scale;}
+    for (int row = 0; row < n; row++) {
+      if (row == col) continue;
+      double factor = H[row][col];
+      for (int k = 0; k < n; k++) {H[row][k] -= factor*H[col][k]; inv[row][k] -= factor*inv[col][k];}
+    }
+  }
+
+  std::vector<double> errors(n);
+  for (int i = 0; i < n; i++) errors[i] = sqrt(2*errorDef*inv[i][i]);
+  return errors;
+}
+
+//Print
+void print_fit(const FitResult &result, std::string title) {
+  std::cout << std::endl;
+  std::cout << title << (result.converged ? " converged" : " did NOT converge") << " after " << result.nCalls << " calls, minimum = " << result.minimum << std::endl;
+  for (int i = 0; i < result.values.size(); i++) {
+    std::cout << "  " << result.names[i] << " = " << result.values[i];
+    if (result.hessianValid) std::cout << " +/- " << result.errors[i] << std::endl;
+    else std::cout << ", error unavailable (Hessian not positive definite)" << std::endl;
+  }
+}
+
+// Initial simplex steps: 10% of each parameter, or 0.1 for parameters near zero
+static std::vector<double> initial_steps(std::vector<double> params) {
+  std::vector<double> steps;
+  for (double p : params) steps.push_back(std::max(0.1*std::abs(p), 0.1));
+  return steps;
+}
+
+/*
+###################
+//Unbinned maximum likelihood
+###################
+*/
+
+UnbinnedFitter::UnbinnedFitter(FiniteFunction* function, std::vector<double> &data, int nThreads) {
+  m_Function = function;
+  m_Threads = thread_count(nThreads);
+  // The function is only normalised over its range, so points outside it can't contribute
+  for (double x : data) {
+    if (x >= m_Function->rangeMin() && x <= m_Function->rangeMax()) m_Data.push_back(x);
+  }
+}
+
+// NLL = -sum(log f(x_i)) + N*log(integral), the sum is split across threads in blocks handed to logFunction
+double UnbinnedFitter::nll(std::vector<double> params) {
+  const double inf = std::numeric_limits<double>::infinity();
+  m_Function->setParameters(params);
+  double integral = m_Function->integral(m_IntDiv);
+  if (!(integral > 0) || !std::isfinite(integral)) return inf;
+
+  const int block = 256;
+  double logSum = parallel_sum(m_Data.size(), [&](long begin, long end) {
+    double buffer[block];
+    double sum = 0;
+    for (long i = begin; i < end; i += block) {
+      int n = std::min<long>(block, end - i);
+      m_Function->logFunction(&m_Data[i], buffer, n);
+      for (int k = 0; k < n; k++) sum += buffer[k];
+    }
+    return sum;
+  }, m_Threads);
+
+  double value = -logSum + m_Data.size()*log(integral);
+  return std::isfinite(value) ? value : inf; // Invalid parameters (e.g. negative widths) give NaN logs
+}
+
+FitResult UnbinnedFitter::fit() {
+  FitResult result;
+  result.names = m_Function->getParameterNames();
+  Objective f = [this](const std::vector<double> &p) {return this->nll(p);};
+
+  std::vector<double> start = m_Function->getParameters();
+  result.values = minimise(f, start, initial_steps(start), result.nCalls, result.converged);
+  result.minimum = f(result.values);
+  result.errors = hessian_errors(hessian(f, result.values, result.nCalls), 0.5, result.hessianValid);
+  return result;
+}
+
+/*
+###################
+//Binned fits
+###################
+*/
+
+BinnedFitter::BinnedFitter(FiniteFunction* function, std::vector<double> counts, int subDiv) {
+  m_Function = function;
+  m_Counts = counts;
+  m_Total = 0;
+  for (double n : m_Counts) m_Total += n;
+  m_SubDiv = std::max(2, subDiv + subDiv%2); // Simpson needs an even number of divisions
+  m_Expected.resize(m_Counts.size());
+
+  int nPoints = m_Counts.size()*m_SubDiv + 1; // Bins share their edge points
+  double h = (m_Function->rangeMax() - m_Function->rangeMin())/(nPoints - 1);
+  for (int i = 0; i < nPoints; i++) m_Grid.push_back(m_Function->rangeMin() + i*h);
+}
+
+// Integrate the model over every bin with Simpson's rule on the shared grid, then scale to the total count.
+// This costs nBins*subDiv evaluations however many points went into the histogram.
+bool BinnedFitter::expected(std::vector<double> params) {
+  m_Function->setParameters(params);
+  const int nBins = m_Counts.size();
+  const double h = m_Grid[1] - m_Grid[0];
+  std::vector<double> fx(m_Grid.size());
+  for (int i = 0; i < fx.size(); i++) fx[i] = m_Function->callFunction(m_Grid[i]);
+
+  double total = 0;
+  for (int b = 0; b < nBins; b++) {
+    const double* f = &fx[b*m_SubDiv];
+    double sum = f[0] + f[m_SubDiv];
+    for (int k = 1; k < m_SubDiv; k++) sum += (k % 2 ? 4 : 2) * f[k];
+    m_Expected[b] = h/3 * sum;
+    total += m_Expected[b];
+  }
+  if (!(total > 0) || !std::isfinite(total)) return false;
+  for (double &nu : m_Expected) {
+    nu *= m_Total/total;
+    if (!(nu >= 0)) return false; // Negative or NaN model values
+  }
+  return true;
+}
+
+// Sum of nu - n + n*log(n/nu), zero for a perfect model and distributed as chi2/2 for large counts
+double BinnedFitter::poissonNLL(std::vector<double> params) {
+  const double inf = std::numeric_limits<double>::infinity();
+  if (!this->expected(params)) return inf;
+  double value = 0;
+  for (int b = 0; b < m_Counts.size(); b++) {
+    double n = m_Counts[b], nu = m_Expected[b];
+    value += nu - n;
+    if (n > 0) value += n*log(n/nu);
+  }
+  return std::isfinite(value) ? value : inf;
+}
+
+// Neyman chi2 uses the observed count as the variance, so empty bins are skipped
+double BinnedFitter::chiSquared(std::vector<double> params) {
+  const double inf = std::numeric_limits<double>::infinity();
+  if (!this->expected(params)) return inf;
+  double value = 0;
+  for (int b = 0; b < m_Counts.size(); b++) {
+    double n = m_Counts[b];
+    if (n <= 0) continue;
+    double d = n - m_Expected[b];
+    value += d*d/n;
+  }
+  return std::isfinite(value) ? value : inf;
+}
+
+FitResult BinnedFitter::fit(const Objective &f, double errorDef) {
+  FitResult result;
+  result.names = m_Function->getParameterNames();
+  std::vector<double> start = m_Function->getParameters();
+  result.values = minimise(f, start, initial_steps(start), result.nCalls, result.converged);
+  result.minimum = f(result.values);
+  result.errors = hessian_errors(hessian(f, result.values, result.nCalls), errorDef, result.hessianValid);
+  return result;
+}
+
+FitResult BinnedFitter::fitPoisson() {
+  return this->fit([this](const std::vector<double> &p) {return this->poissonNLL(p);}, 0.5);
+}
+
+FitResult BinnedFitter::fitChiSquared() {
+  return this->fit([this](const std::vector<double> &p) {return this->chiSquared(p);}, 1.0);
+}
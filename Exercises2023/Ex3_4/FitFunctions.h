@@ -0,0 +1,169 @@
+/**
+ * @file FitFunctions.h
+ * @author Kierran Falloon (kierran.falloon@strath.ac.uk)
+ * @date 05-12-2023
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <numeric>
+#include <string>
+#include <vector>
+#include "FiniteFunctions.h"
+
+#pragma once
+
+typedef std::function<double(const std::vector<double>&)> Objective; // Function of the parameters to be minimised
+
+struct FitResult {
+  std::vector<std::string> names; // Parameter names
+  std::vector<double> values; // Best fit parameter values
+  std::vector<double> errors; // Parabolic errors from the inverse Hessian
+  double minimum; // Objective at the best fit (NLL or chi2)
+  int nCalls; // Number of objective evaluations
+  bool converged;
+  bool hessianValid; // False if the Hessian at the best fit isn't positive definite, the errors are then NaN
+};
+
+// Storage for minimise_with, kept by the caller so repeated fits on one thread (e.g. bootstrap replicates) don't allocate
+struct SimplexScratch {
+  std::vector<std::vector<double>> simplex; // n+1 vertices
+  std::vector<double> values; // Objective at each vertex
+  std::vector<double> steps; // Current simplex size, shrunk for the restart
+  std::vector<double> centroid, trial, other; // Centroid and candidate points
+  std::vector<int> order; // Vertices sorted by value
+};
+
+// Nelder-Mead downhill simplex of f (any callable double(const std::vector<double>&)) starting from start, with
+// initial simplex size steps, best point written to best. Once scratch and best have been through one fit of the same
+// dimension nothing is allocated.
+template <typename F>
+void minimise_with(const F &f, const std::vector<double> &start, const std::vector<double> &steps, std::vector<double> &best, SimplexScratch &s, int &nCalls, bool &converged, double tolerance = 1e-10, int maxCalls = 5000);
+
+// Nelder-Mead simplex minimisation of f starting from start, with initial simplex size steps
+std::vector<double> minimise(const Objective &f, std::vector<double> start, std::vector<double> steps, int &nCalls, bool &converged, double tolerance = 1e-10, int maxCalls = 5000);
+// Numerical Hessian of f at point using central differences
+std::vector<std::vector<double>> hessian(const Objective &f, std::vector<double> point, int &nCalls);
+// Parameter errors from the Hessian, errorDef is 0.5 for an NLL and 1 for a chi2. valid is false (and the errors NaN)
+// unless H is positive definite
+std::vector<double> hessian_errors(std::vector<std::vector<double>> H, double errorDef, bool &valid);
+void print_fit(const FitResult &result, std::string title); // Dump fit results
+
+class UnbinnedFitter{
+
+public:
+  UnbinnedFitter(FiniteFunction* function, std::vector<double> &data, int nThreads = 0); //nThreads <= 0 uses every hardware thread
+  double nll(std::vector<double> params); // Negative log-likelihood, leaves the function set to params
+  FitResult fit(); // Minimise the NLL starting from the function's current parameters, leaves the function at the best fit
+
+private:
+  FiniteFunction* m_Function;
+  std::vector<double> m_Data; // Data points inside the function range
+  int m_Threads;
+  int m_IntDiv = 1000; // Divisions used to normalise the function over its range
+};
+
+class BinnedFitter{
+
+public:
+  BinnedFitter(FiniteFunction* function, std::vector<double> counts, int subDiv = 8); //counts in equal bins over the function range, e.g. from binData
+  double poissonNLL(std::vector<double> params); // Poisson likelihood ratio -log(L/L_saturated), leaves the function set to params
+  double chiSquared(std::vector<double> params); // Neyman chi2 over the non-empty bins, leaves the function set to params
+  FitResult fitPoisson(); // Minimise poissonNLL from the function's current parameters
+  FitResult fitChiSquared(); // Minimise chiSquared from the function's current parameters
+
+private:
+  FiniteFunction* m_Function;
+  std::vector<double> m_Counts;
+  double m_Total; // Sum of the counts
+  int m_SubDiv; // Simpson divisions per bin (even)
+  std::vector<double> m_Grid; // Shared Simpson grid over all bins
+  std::vector<double> m_Expected; // Scratch for the expected counts per bin
+  bool expected(std::vector<double> params); // Fill m_Expected with N * (bin integral / range integral), false for invalid parameters
+  FitResult fit(const Objective &f, double errorDef);
+};
+
+// Restarts once around the best point to avoid a collapsed simplex stopping early
+template <typename F>
+void minimise_with(const F &f, const std::vector<double> &start, const std::vector<double> &steps, std::vector<double> &best, SimplexScratch &s, int &nCalls, bool &converged, double tolerance, int maxCalls) {
+  const int n = start.size();
+  nCalls = 0;
+  converged = (n == 0);
+  best.assign(start.begin(), start.end());
+  if (n == 0) return;
+  s.simplex.resize(n+1);
+  s.values.resize(n+1);
+  s.steps.assign(steps.begin(), steps.end());
+  s.centroid.resize(n);
+  s.trial.resize(n);
+  s.other.resize(n);
+  s.order.resize(n+1);
+  double bestValue = f(best); nCalls++;
+
+  for (int restart = 0; restart < 2; restart++) {
+    // Build initial simplex: best point plus one step along each axis
+    for (int j = 0; j <= n; j++) {
+      s.simplex[j].assign(best.begin(), best.end());
+      s.values[j] = bestValue;
+    }
+    for (int i = 0; i < n; i++) {
+      s.simplex[i+1][i] += s.steps[i];
+      s.values[i+1] = f(s.simplex[i+1]); nCalls++;
+    }
+
+    std::vector<double> &values = s.values;
+    bool done = false;
+    while (nCalls < maxCalls) {
+      std::iota(s.order.begin(), s.order.end(), 0);
+      std::sort(s.order.begin(), s.order.end(), [&](int a, int b) {return values[a] < values[b];});
+      int lo = s.order[0], hi = s.order[n], nh = s.order[n-1];
+
+      // Stop when the spread in the simplex is below tolerance (relative to the minimum)
+      if (std::abs(values[hi] - values[lo]) <= tolerance * (std::abs(values[lo]) + tolerance)) {
+        done = true;
+        break;
+      }
+
+      std::fill(s.centroid.begin(), s.centroid.end(), 0.0); // Centroid of all but the worst point
+      for (int j = 0; j <= n; j++) {
+        if (j == hi) continue;
+        for (int i = 0; i < n; i++) s.centroid[i] += s.simplex[j][i]/n;
+      }
+      auto along = [&](double t, std::vector<double> &p) { // centroid + t*(worst - centroid)
+        for (int i = 0; i < n; i++) p[i] = s.centroid[i] + t*(s.simplex[hi][i] - s.centroid[i]);
+      };
+
+      along(-1.0, s.trial); // Reflected
+      double fr = f(s.trial); nCalls++;
+      if (fr < values[lo]) { // Try expanding further in the same direction
+        along(-2.0, s.other);
+        double fe = f(s.other); nCalls++;
+        if (fe < fr) {s.simplex[hi].swap(s.other); values[hi] = fe;}
+        else {s.simplex[hi].swap(s.trial); values[hi] = fr;}
+      }
+      else if (fr < values[nh]) {
+        s.simplex[hi].swap(s.trial); values[hi] = fr;
+      }
+      else { // Contract towards the centroid (outside if reflection helped a little, inside otherwise)
+        along(fr < values[hi] ? -0.5 : 0.5, s.other);
+        double fc = f(s.other); nCalls++;
+        if (fc < std::min(fr, values[hi])) {s.simplex[hi].swap(s.other); values[hi] = fc;}
+        else { // Shrink everything towards the best point
+          for (int j = 0; j <= n; j++) {
+            if (j == lo) continue;
+            for (int i = 0; i < n; i++) s.simplex[j][i] = s.simplex[lo][i] + 0.5*(s.simplex[j][i] - s.simplex[lo][i]);
+            values[j] = f(s.simplex[j]); nCalls++;
+          }
+        }
+      }
+    }
+
+    int lo = std::min_element(values.begin(), values.end()) - values.begin();
+    bool improved = values[lo] < bestValue - tolerance * (std::abs(bestValue) + tolerance);
+    if (values[lo] < bestValue) {best.assign(s.simplex[lo].begin(), s.simplex[lo].end()); bestValue = values[lo];}
+    converged = done;
+    if (!done || (restart > 0 && !improved)) break;
+    for (double &step : s.steps) step *= 0.1; // Smaller simplex for the restart
+  }
+}
@@ -0,0 +1,118 @@
+/**
+ * @file GenerateRandomData.cxx
+ * @author Kierran Falloon (kierran.falloon@strath.ac.uk)
+ * @version 1.0
+ * @date 5-12-2023
+ *
+ * Writes samples of a FiniteFunction to a data file, by default 100000 values to Outputs/data/MysteryData<seed>.txt
+ * like the original generator. Sampling and formatting run on every core and the file is written in order, so the
+ * output depends only on the seed and large files are limited by the disk.
+ * Called via ./GenerateRandomData.out [--function normal|cauchy|crystal|default] [--params p1,p2,...]
+ *   [--range min,max] [--count N] [--seed S] [--threads T] [--binary] [--digits D] [--output file]
+ */
+
+#include <iostream>
+#include <cmath>
+#include <iomanip>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "FiniteFunctions.h"
+#include "CustomFunctions.h"
+#include "DataGenerator.h"
+
+// Comma separated numbers, e.g. "2,1.5"
+std::vector<double> parse_list(std::string text) {
+  std::vector<double> values;
+  std::stringstream stream(text);
+  for (std::string item; std::getline(stream, item, ',');) values.push_back(std::stod(item));
+  return values;
+}
+
+// Non-negative integer, plain digits or 1e9 style; exits on anything negative, non-numeric or past 2^64
+std::uint64_t parse_count(std::string value, std::string what) {
+  double count = NAN;
+  try {
+    std::size_t used = 0;
+    if (!value.empty() && value.find_first_not_of("0123456789") == std::string::npos) return std::stoull(value);
+    count = std::stod(value, &used);
+    if (used != value.size()) count = NAN;
+  }
+  catch (const std::exception &) {} // Out of range or not a number at all
+  if (!(count >= 0) || count >= 18446744073709551616.0) {
+    std::cout << "Can't use " << value << " as " << what << std::endl;
+    exit(1);
+  }
+  return static_cast<std::uint64_t>(std::round(count));
+}
+
+// parse_count limited to [min, max], for the thread count and digits
+int parse_int(std::string value, std::string what, int min, int max) {
+  std::uint64_t count = parse_count(value, what);
+  if (count < static_cast<std::uint64_t>(min) || count > static_cast<std::uint64_t>(max)) {
+    std::cout << "Can't use " << value << " as " << what << ", it must be between " << min << " and " << max << std::endl;
+    exit(1);
+  }
+  return static_cast<int>(count);
+}
+
+// Function to sample, params in getParameters() order with the CustomFunctions defaults for any left out
+std::unique_ptr<FiniteFunction> make_function(std::string name, std::vector<double> p, double min, double max) {
+  auto param = [&](int i, double fallback) {return i < p.size() ? p[i] : fallback;};
+  if (name == "normal") return std::make_unique<NormalDistributionFunction>(min, max, "Generate-Normal", param(0, 0.0), param(1, 1.0));
+  if (name == "cauchy") return std::make_unique<CauchyLorentzDistribution>(min, max, "Generate-Cauchy", param(0, 0.0), param(1, 1.0));
+  if (name == "crystal") return std::make_unique<NegativeCrystalBallDistribution>(min, max, "Generate-Crystal", param(0, 0.0), param(1, 1.0), param(2, 1.0), param(3, 2.0));
+  if (name == "default") return std::make_unique<FiniteFunction>(min, max, "Generate-Default");
+  std::cout << "Unknown function " << name << ", expected normal, cauchy, crystal or default" << std::endl;
+  exit(1);
+}
+
+int main(int argc, char *argv[]) {
+  std::string function = "normal", output;
+  std::vector<double> params, range = {-10, 10};
+  std::uint64_t count = 100000, seed = std::random_device{}();
+  int nThreads = 0, digits = 6;
+  bool binary = false;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--binary") {binary = true; continue;}
+    if (i + 1 >= argc) {
+      std::cout << "Usage: ./GenerateRandomData.out [--function normal|cauchy|crystal|default] [--params p1,p2,...] [--range min,max] [--count N] [--seed S] [--threads T] [--binary] [--digits D] [--output file]" << std::endl;
+      return 1;
+    }
+    std::string value = argv[++i];
+    if (arg == "--function") function = value;
+    else if (arg == "--params") params = parse_list(value);
+    else if (arg == "--range") range = parse_list(value);
+    else if (arg == "--count") count = parse_count(value, "a count"); // Accepts 1e9
+    else if (arg == "--seed") seed = parse_count(value, "a seed");
+    else if (arg == "--threads") nThreads = parse_int(value, "a number of threads", 0, 4096); // 0 = every hardware thread
+    else if (arg == "--digits") digits = parse_int(value, "a number of digits", 0, 17); // More than 17 adds nothing to a double
+    else if (arg == "--output") output = value;
+    else {
+      std::cout << "Unknown option " << arg << std::endl;
+      return 1;
+    }
+  }
+  if (range.size() != 2 || !(range[0] < range[1])) {
+    std::cout << "--range needs min,max with min < max" << std::endl;
+    return 1;
+  }
+  if (output.empty()) {
+    std::stringstream name;
+    name << "Outputs/data/MysteryData" << std::setw(5) << std::setfill('0') << seed % 100000 << (binary ? ".data" : ".txt");
+    output = name.str();
+  }
+
+  std::unique_ptr<FiniteFunction> f = make_function(function, params, range[0], range[1]);
+  GenerateResult result = generate_data(f.get(), output, count, seed, nThreads, binary, digits);
+  if (result.rows == 0 && count > 0) return 1; // File couldn't be opened
+
+  std::cout << "Wrote " << result.rows << " samples of " << function << " (" << result.sampler << ", seed " << seed << ") to " << output << std::endl;
+  std::cout << "  " << result.bytes/1e6 << " MB in " << result.seconds << " s, " << result.rows/result.seconds/1e6 << " M rows/s, " << result.bytes/result.seconds/1e6 << " MB/s" << std::endl;
+  if (result.violations) std::cout << "  Warning: the function exceeded its envelope " << result.violations << " times, the samples are slightly biased there" << std::endl;
+  return 0;
+}
@@ -0,0 +1,147 @@
+/**
+ * @file GoodnessOfFit.cxx
+ * @author Kierran Falloon (kierran.falloon@strath.ac.uk)
+ * @date 05-12-2023
+ */
+
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include "GoodnessOfFit.h"
+#include "Parallel.h"
+
+/*
+###################
+//CDF table
+###################
+*/
+
+CDFTable::CDFTable(FiniteFunction* function, int nDiv) {
+  m_Min = function->rangeMin();
+  double h = (function->rangeMax() - m_Min)/nDiv;
+  m_InvH = 1/h;
+  m_Table.resize(nDiv+1);
+  m_Table[0] = 0;
+  double previous = function->callFunction(m_Min);
+  for (int i = 1; i <= nDiv; i++) {
+    double current = function->callFunction(m_Min + i*h);
+    m_Table[i] = m_Table[i-1] + 0.5*h*(previous + current);
+    previous = current;
+  }
+  double total = m_Table[nDiv];
+  for (double &c : m_Table) c /= total;
+}
+
+double CDFTable::operator()(double x) const {
+  double u = (x - m_Min)*m_InvH;
+  int last = m_Table.size() - 1;
+  int i = std::clamp(static_cast<int>(u), 0, last - 1);
+  double t = std::clamp(u - i, 0.0, 1.0);
+  return m_Table[i] + t*(m_Table[i+1] - m_Table[i]);
+}
+
+/*
+###################
+//Sorting
+###################
+*/
+
+// Each thread sorts a contiguous chunk, then neighbouring chunks are merged in parallel rounds
+void parallel_sort(std::vector<double> &data, int nThreads) {
+  const long n = data.size();
+  const int nChunks = std::min<long>(thread_count(nThreads), std::max(1L, n/4096));
+  std::vector<long> bounds(nChunks+1);
+  for (int c = 0; c <= nChunks; c++) bounds[c] = n*c/nChunks;
+
+  parallel_for(nChunks, [&](long begin, long end, int) {
+    for (long c = begin; c < end; c++) std::sort(data.begin() + bounds[c], data.begin() + bounds[c+1]);
+  }, nThreads, 1);
+
+  for (int width = 1; width < nChunks; width *= 2) {
+    int nMerges = (nChunks + 2*width - 1)/(2*width);
+    parallel_for(nMerges, [&](long begin, long end, int) {
+      for (long m = begin; m < end; m++) {
+        int lo = m*2*width;
+        int mid = std::min(lo + width, nChunks);
+        int hi = std::min(lo + 2*width, nChunks);
+        std::inplace_merge(data.begin() + bounds[lo], data.begin() + bounds[mid], data.begin() + bounds[hi]);
+      }
+    }, nThreads, 1);
+  }
+}
+
+/*
+###################
+//Test statistics
+###################
+*/
+
+// Asymptotic Kolmogorov distribution with Stephens' small sample correction
+double kolmogorov_pvalue(double D, long n) {
+  double sqrtN = sqrt((double)n);
+  double lambda = (sqrtN + 0.12 + 0.11/sqrtN)*D;
+  if (lambda < 0.2) return 1.0;
+  double sum = 0;
+  for (int k = 1; k <= 100; k++) {
+    double term = exp(-2*k*k*lambda*lambda);
+    sum += (k % 2 ? 2 : -2)*term;
+    if (term < 1e-12) break;
+  }
+  return std::clamp(sum, 0.0, 1.0);
+}
+
+// With F_i the model CDF at the i-th smallest point (i = 1..n):
+//   D   = max(i/n - F_i, F_i - (i-1)/n)
+//   W^2 = 1/(12n) + sum (F_i - (2i-1)/(2n))^2
+//   A^2 = -n - (1/n) sum [(2i-1) ln F_i + (2n-2i+1) ln(1-F_i)]
+// The A^2 form pairs each point with itself rather than with point n+1-i, so every term only needs F_i.
+GoodnessOfFit goodness_of_fit_sorted(const CDFTable &cdf, const std::vector<double> &sorted, int nThreads) {
+  GoodnessOfFit gof;
+  const long n = sorted.size();
+  gof.n = n;
+  if (n == 0) return gof;
+
+  const int nParts = thread_count(nThreads);
+  std::vector<double> partD(nParts, 0.0), partW(nParts, 0.0), partA(nParts, 0.0);
+  const double tiny = 1e-300;
+  parallel_for(n, [&](long begin, long end, int c) {
+    double D = 0, W = 0, A = 0;
+    for (long k = begin; k < end; k++) {
+      double i = k + 1;
+      double F = std::clamp(cdf(sorted[k]), tiny, 1 - 1e-16);
+      D = std::max(D, std::max(i/n - F, F - (i-1)/n));
+      double d = F - (2*i - 1)/(2.0*n);
+      W += d*d;
+      A += (2*i - 1)*log(F) + (2.0*n - 2*i + 1)*log(1 - F);
+    }
+    partD[c] = D;
+    partW[c] = W;
+    partA[c] = A;
+  }, nThreads);
+
+  double W = 0, A = 0;
+  for (int c = 0; c < nParts; c++) {
+    gof.ks = std::max(gof.ks, partD[c]);
+    W += partW[c];
+    A += partA[c];
+  }
+  gof.cvm = 1.0/(12.0*n) + W;
+  gof.ad = -n - A/n;
+  gof.ksPValue = kolmogorov_pvalue(gof.ks, n);
+  return gof;
+}
+
+GoodnessOfFit goodness_of_fit(FiniteFunction* function, const std::vector<double> &data, int nThreads) {
+  std::vector<double> sorted;
+  sorted.reserve(data.size());
+  for (double x : data) {
+    if (x >= function->rangeMin() && x <= function->rangeMax()) sorted.push_back(x);
+  }
+  parallel_sort(sorted, nThreads);
+  return goodness_of_fit_sorted(CDFTable(function), sorted, nThreads);
+}
+
+//Print
+void print_gof(const GoodnessOfFit &gof, std::string title) {
+  std::cout << title << " goodness of fit (" << gof.n << " points): KS D = " << gof.ks << " (p = " << gof.ksPValue << "), Anderson-Darling A2 = " << gof.ad << ", Cramer-von Mises W2 = " << gof.cvm << std::endl;
+}
@@ -0,0 +1,39 @@
+/**
+ * @file GoodnessOfFit.h
+ * @author Kierran Falloon (kierran.falloon@strath.ac.uk)
+ * @date 05-12-2023
+ */
+
+#include <string>
+#include <vector>
+#include "FiniteFunctions.h"
+
+#pragma once
+
+// Normalised CDF of a FiniteFunction over its range, from a cumulative trapezoid table built once for the current
+// parameters. Lookups interpolate linearly between nodes in O(1).
+class CDFTable{
+
+public:
+  CDFTable(FiniteFunction* function, int nDiv = 16384);
+  double operator()(double x) const;
+
+private:
+  double m_Min;
+  double m_InvH; //1/node spacing
+  std::vector<double> m_Table; //CDF at each node, 0 at rangeMin and 1 at rangeMax
+};
+
+struct GoodnessOfFit {
+  long n = 0; // Points used (those inside the function range)
+  double ks = 0; // Kolmogorov-Smirnov distance D
+  double ksPValue = 0; // Asymptotic Kolmogorov p-value for D
+  double ad = 0; // Anderson-Darling A^2
+  double cvm = 0; // Cramer-von Mises W^2
+};
+
+void parallel_sort(std::vector<double> &data, int nThreads = 0); // Sort chunks in parallel then merge them pairwise
+GoodnessOfFit goodness_of_fit_sorted(const CDFTable &cdf, const std::vector<double> &sorted, int nThreads = 0); // All three statistics in one pass over sorted data
+GoodnessOfFit goodness_of_fit(FiniteFunction* function, const std::vector<double> &data, int nThreads = 0); // Select in-range data, sort, tabulate the CDF and test
+double kolmogorov_pvalue(double D, long n);
+void print_gof(const GoodnessOfFit &gof, std::string title);
@@ -0,0 +1,107 @@
+/**
+ * @file GridScan.cxx
+ * @author Kierran Falloon (kierran.falloon@strath.ac.uk)
+ * @date 05-12-2023
+ */
+
+#include <iostream>
+#include <cmath>
+#include "GridScan.h"
+#include "CustomFunctions.h"
+#include "FitFunctions.h"
+#include "DataWriter.h"
+
+// Full parameter vector at a cell, decoding the index with the last axis fastest
+std::vector<double> GridScanResult::parameters(long cell) const {
+  std::vector<double> params = fixed;
+  for (int a = axes.size() - 1; a >= 0; a--) {
+    params[axes[a].parameter] = axes[a].value(cell % axes[a].n);
+    cell /= axes[a].n;
+  }
+  return params;
+}
+
+GridAxis grid_axis(int parameter, double value, double width, int n) {
+  return {parameter, value - width, value + width, n};
+}
+
+// Build one density per cell with make(params) and run the tiled kernel over them
+template <typename D, typename Make>
+static std::vector<double> scan_static(const GridScanResult &grid, long nCells, Make make, const std::vector<double> &data, double min, double max, int intDiv, int nThreads) {
+  std::vector<D> densities;
+  densities.reserve(nCells);
+  for (long c = 0; c < nCells; c++) densities.push_back(make(grid.parameters(c)));
+  return nll_grid(densities, data, min, max, intDiv, nThreads);
+}
+
+GridScanResult scan_nll(FiniteFunction* function, std::vector<double> &data, std::vector<GridAxis> axes, int nThreads, int intDiv) {
+  GridScanResult result;
+  result.axes = axes;
+  result.fixed = function->getParameters();
+  std::vector<std::string> names = function->getParameterNames();
+  long nCells = 1;
+  for (GridAxis &axis : result.axes) {
+    if (axis.parameter < 0 || axis.parameter >= result.fixed.size() || axis.n < 1) {
+      std::cout << "Grid axis for parameter " << axis.parameter << " is invalid, " << result.fixed.size() << " parameters available" << std::endl;
+      exit(1);
+    }
+    result.names.push_back(names[axis.parameter]);
+    nCells *= axis.n;
+  }
+
+  const double min = function->rangeMin(), max = function->rangeMax();
+  std::vector<double> inRange; // Same selection as UnbinnedFitter
+  for (double x : data) {
+    if (x >= min && x <= max) inRange.push_back(x);
+  }
+  result.nData = inRange.size();
+
+  if (dynamic_cast<NormalDistributionFunction*>(function)) {
+    result.nll = scan_static<NormalDensity>(result, nCells, [](const std::vector<double> &p) {return NormalDensity(p[0], p[1]);}, inRange, min, max, intDiv, nThreads);
+  }
+  else if (dynamic_cast<CauchyLorentzDistribution*>(function)) {
+    result.nll = scan_static<CauchyLorentzDensity>(result, nCells, [](const std::vector<double> &p) {return CauchyLorentzDensity(p[0], p[1]);}, inRange, min, max, intDiv, nThreads);
+  }
+  else if (dynamic_cast<NegativeCrystalBallDistribution*>(function)) {
+    result.nll = scan_static<NegativeCrystalBallDensity>(result, nCells, [](const std::vector<double> &p) {return NegativeCrystalBallDensity(p[0], p[1], p[2], p[3]);}, inRange, min, max, intDiv, nThreads);
+  }
+  else { // No static density, one virtual pass over the data per cell
+    UnbinnedFitter fitter(function, data, nThreads);
+    for (long c = 0; c < nCells; c++) result.nll.push_back(fitter.nll(result.parameters(c)));
+    function->setParameters(result.fixed);
+  }
+
+  for (long c = 1; c < nCells; c++) {
+    if (result.nll[c] < result.nll[result.best]) result.best = c;
+  }
+  return result;
+}
+
+void export_grid(const GridScanResult &result, std::string filename, bool binary) {
+  std::string header;
+  for (const std::string &name : result.names) header += name + ",";
+  DataWriter writer(filename, binary, header + "nll,delta_nll");
+  if (!writer.good()) return;
+
+  int nCols = result.axes.size() + 2;
+  int fastest = result.axes.empty() ? 1 : result.axes.back().n;
+  writer.section(binary ? "grid" : "", result.nll.size(), nCols); // No CSV prefix, so gnuplot can read the columns directly
+  std::vector<double> row(nCols);
+  for (long c = 0; c < result.nll.size(); c++) {
+    std::vector<double> params = result.parameters(c);
+    for (int a = 0; a < result.axes.size(); a++) row[a] = params[result.axes[a].parameter];
+    row[nCols-2] = result.nll[c];
+    row[nCols-1] = result.nll[c] - result.minimum();
+    writer.row(row.data(), nCols);
+    if ((c+1) % fastest == 0 && c+1 < result.nll.size()) writer.text(""); // Blank line between scan lines
+  }
+}
+
+void print_grid(const GridScanResult &result, std::string title) {
+  std::cout << std::endl << title << " over " << result.nll.size() << " cells (" << result.nData << " points), minimum = " << result.minimum() << std::endl;
+  std::vector<double> params = result.parameters(result.best);
+  for (int a = 0; a < result.axes.size(); a++) {
+    const GridAxis &axis = result.axes[a];
+    std::cout << "  " << result.names[a] << " = " << params[axis.parameter] << " (scanned " << axis.min << " to " << axis.max << " in " << axis.n << " steps)" << std::endl;
+  }
+}
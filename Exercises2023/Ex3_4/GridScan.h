@@ -0,0 +1,97 @@
+/**
+ * @file GridScan.h
+ * @author Kierran Falloon (kierran.falloon@strath.ac.uk)
+ * @date 05-12-2023
+ *
+ * Unbinned NLL over a regular grid of parameter values, for starting points, spotting multiple minima and contours.
+ * The distributions in CustomFunctions.h are scanned through their StaticFunctions densities, anything else falls
+ * back to UnbinnedFitter::nll one cell at a time.
+ */
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <vector>
+#include "FiniteFunctions.h"
+#include "Parallel.h"
+#include "StaticFunctions.h"
+
+#pragma once
+
+struct GridAxis {
+  int parameter; // Index into getParameters()
+  double min, max;
+  int n; // Grid points along this axis, both ends included
+  double value(int i) const {return n > 1 ? min + i*(max - min)/(n - 1) : min;}
+};
+
+struct GridScanResult {
+  std::vector<std::string> names; // Scanned parameter names, one per axis
+  std::vector<GridAxis> axes;
+  std::vector<double> fixed; // Full parameter vector the unscanned parameters are taken from
+  std::vector<double> nll; // One value per cell, last axis fastest, +inf for invalid parameters
+  long best = 0; // Cell with the lowest NLL
+  long nData = 0; // Points inside the function range
+  std::vector<double> parameters(long cell) const; // Full parameter vector at a cell
+  double minimum() const {return nll[best];}
+};
+
+// NLL on every cell of the grid spanned by axes, other parameters held at the function's current values.
+// The function is left with its original parameters.
+GridScanResult scan_nll(FiniteFunction* function, std::vector<double> &data, std::vector<GridAxis> axes, int nThreads = 0, int intDiv = 1000);
+// Grid axis of n points centred on value, +-width either side
+GridAxis grid_axis(int parameter, double value, double width, int n);
+// CSV (parameters, nll, nll - minimum, blank line after each run of the last axis for gnuplot splot) or DataWriter binary
+void export_grid(const GridScanResult &result, std::string filename, bool binary = false);
+void print_grid(const GridScanResult &result, std::string title); // Best cell and grid size
+
+/*
+###################
+//Kernel
+###################
+*/
+
+// NLL for each density over data already restricted to [min, max].
+// Cells are taken in blocks of 64 and the data in tiles of 2048 points (16 kB, stays in L1), so each tile is
+// loaded once per block rather than once per cell. Within a block, 8 cells share each data point with independent
+// accumulators, which is the loop the compiler vectorises across parameter points. Blocks are spread over threads.
+template <typename D>
+std::vector<double> nll_grid(const std::vector<D> &densities, const std::vector<double> &data, double min, double max, int intDiv, int nThreads = 0) {
+  const int lanes = 8, groups = 8, tile = 2048;
+  const int block = lanes*groups;
+  const double inf = std::numeric_limits<double>::infinity();
+  long nCells = densities.size();
+  long nBlocks = (nCells + block - 1)/block;
+  long nData = data.size();
+  std::vector<double> nll(nCells, inf);
+
+  parallel_for(nBlocks, [&](long begin, long end, int) {
+    for (long b = begin; b < end; b++) {
+      long first = b*block;
+      std::array<D, block> d; // Padded with the last cell so every group is full
+      for (int c = 0; c < block; c++) d[c] = densities[std::min(first + c, nCells - 1)];
+      std::array<double, block> acc{};
+
+      for (long t = 0; t < nData; t += tile) {
+        long tEnd = std::min<long>(t + tile, nData);
+        for (int g = 0; g < groups; g++) {
+          double* a = &acc[g*lanes];
+          const D* dg = &d[g*lanes];
+          for (long i = t; i < tEnd; i++) {
+            double x = data[i];
+            for (int c = 0; c < lanes; c++) a[c] += dg[c].logValue(x);
+          }
+        }
+      }
+
+      for (int c = 0; c < block && first + c < nCells; c++) {
+        double integral = integrate_density(d[c], min, max, intDiv);
+        double value = -acc[c] + nData*log(integral);
+        if (integral > 0 && std::isfinite(value)) nll[first + c] = value;
+      }
+    }
+  }, nThreads, 1);
+  return nll;
+}
@@ -9,13 +9,15 @@
 #include <vector>
 #include <array>
 #include <cmath>
+#include <algorithm>
+#include "HelperFunctions.h"
+#include "Parallel.h"
 
 // read file
-std::vector<double> read_file()
+std::vector<double> read_file(std::string filepath, bool verbose)
 {
 
   std::ifstream inputfile; // Open file
-  std::string filepath = "Outputs/data/MysteryData04113.txt";
   inputfile.open(filepath);
 
   if (inputfile.fail() || !inputfile.is_open())
@@ -23,7 +25,7 @@ std::vector<double> read_file()
     std::cout << "Could not open file " + filepath + "" << std::endl;
     exit(1);
   }
-  else
+  else if (verbose)
   { // If file is opened successfully, print success message
     std::cout << "File " + filepath + " opened successfully." << std::endl;
   }
@@ -39,15 +41,120 @@ std::vector<double> read_file()
 
   inputfile.close(); // Close file
 
-  std::cout << "File " + filepath + " read successfully." << std::endl;
-  std::cout << "Number of lines read: " + std::to_string(data.size()) + "\n"
-            << std::endl;
+  if (verbose)
+  {
+    std::cout << "File " + filepath + " read successfully." << std::endl;
+    std::cout << "Number of lines read: " + std::to_string(data.size()) + "\n"
+              << std::endl;
+  }
 
   return data;
 }
 
+// stream a file into a quantile sketch, memory use doesn't grow with the file
+QuantileSketch sketch_file(std::string filepath, int k)
+{
+  std::ifstream inputfile(filepath);
+  if (inputfile.fail() || !inputfile.is_open())
+  { // If file cannot be opened, print error message and exit
+    std::cout << "Could not open file " + filepath + "" << std::endl;
+    exit(1);
+  }
+  QuantileSketch sketch(k);
+  std::string line;
+  while (getline(inputfile, line))
+  {
+    sketch.add(std::stod(line));
+  }
+  return sketch;
+}
+
+/*
+###################
+//Summary statistics
+###################
+*/
+
+double Summary::stdev() const {return sqrt(this->variance());}
+double Summary::skewness() const {return m2 > 0 ? sqrt((double)n) * m3 / pow(m2, 1.5) : 0;}
+double Summary::kurtosis() const {return m2 > 0 ? n * m4 / (m2*m2) - 3 : 0;}
+
+// Pebay's pairwise update for the central moments of the union of two samples
+Summary merge_summary(const Summary &a, const Summary &b)
+{
+  if (a.n == 0) return b;
+  if (b.n == 0) return a;
+  Summary out;
+  double na = a.n, nb = b.n, n = na + nb;
+  double delta = b.mean - a.mean;
+  double delta2 = delta*delta;
+  out.n = a.n + b.n;
+  out.min = std::min(a.min, b.min);
+  out.max = std::max(a.max, b.max);
+  out.mean = a.mean + delta*nb/n;
+  out.m2 = a.m2 + b.m2 + delta2*na*nb/n;
+  out.m3 = a.m3 + b.m3 + delta2*delta*na*nb*(na - nb)/(n*n) + 3*delta*(na*b.m2 - nb*a.m2)/n;
+  out.m4 = a.m4 + b.m4 + delta2*delta2*na*nb*(na*na - na*nb + nb*nb)/(n*n*n)
+         + 6*delta2*(na*na*b.m2 + nb*nb*a.m2)/(n*n) + 4*delta*(na*b.m3 - nb*a.m3)/n;
+  return out;
+}
+
+// Exact moments of a block small enough to stay in L1, as flat loops the compiler can vectorise
+static Summary summarise_block(const double* x, int n)
+{
+  Summary out;
+  out.n = n;
+  double sum = 0, min = x[0], max = x[0];
+  for (int i = 0; i < n; i++)
+  {
+    sum += x[i];
+    min = std::min(min, x[i]);
+    max = std::max(max, x[i]);
+  }
+  out.mean = sum / n;
+  out.min = min;
+  out.max = max;
+  double m2 = 0, m3 = 0, m4 = 0;
+  for (int i = 0; i < n; i++)
+  {
+    double d = x[i] - out.mean;
+    double d2 = d*d;
+    m2 += d2;
+    m3 += d2*d;
+    m4 += d2*d2;
+  }
+  out.m2 = m2;
+  out.m3 = m3;
+  out.m4 = m4;
+  return out;
+}
+
+// Each thread walks its chunk block by block, merging block summaries, then the chunk summaries are merged in order
+Summary summarise(const std::vector<double> &data, int nThreads)
+{
+  const int block = 512;
+  std::vector<Summary> partial(thread_count(nThreads));
+  parallel_for(data.size(), [&](long begin, long end, int c) {
+    Summary local;
+    for (long i = begin; i < end; i += block)
+    {
+      local = merge_summary(local, summarise_block(&data[i], std::min<long>(block, end - i)));
+    }
+    partial[c] = local;
+  }, nThreads);
+  Summary total;
+  for (Summary &p : partial) total = merge_summary(total, p);
+  return total;
+}
+
+// integer bounds slightly wider than the data range
+std::array<int,2> data_range(const Summary &summary)
+{
+  return {(int)std::floor(summary.min) - 2, (int)std::ceil(summary.max) + 2};
+}
+
 // get integer bounds of the data
-std::array<int,2> data_range(std::vector<double> data) {
+std::array<int,2> data_range(const std::vector<double> &data) {
   std::array<int,2> data_range;
   double min = data[0];
   double max = data[0];
@@ -69,7 +176,7 @@ std::array<int,2> data_range(std::vector<double> data) {
 }
 
 // return mean of data
-double get_mean(std::vector<double> data)
+double get_mean(const std::vector<double> &data)
 {
   double sum = 0;
   for (int i = 0; i < data.size(); i++)
@@ -80,12 +187,13 @@ double get_mean(std::vector<double> data)
 }
 
 // return standard deviation of data
-double stdev(std::vector<double> data, double mean_value)
+double stdev(const std::vector<double> &data, double mean_value)
 {
   double sum = 0;
   for (int i = 0; i < data.size(); i++)
   {
-    sum += pow(data[i] - mean_value, 2);
+    double d = data[i] - mean_value;
+    sum += d * d;
   }
   return sqrt(sum / data.size());
 }
\ No newline at end of file
@@ -7,10 +7,29 @@
 #include <iostream>
 #include <vector>
 #include <array>
+#include <string>
+#include "QuantileSketch.h"
 
 #pragma once
 
-std::vector<double> read_file();
-std::array<int,2> data_range(std::vector<double>);
-double get_mean(std::vector<double>);
-double stdev(std::vector<double>, double);
\ No newline at end of file
+std::vector<double> read_file(std::string filepath = "Outputs/data/MysteryData04113.txt", bool verbose = true);
+QuantileSketch sketch_file(std::string filepath, int k = 200); // Stream a file into a quantile sketch without storing it
+
+struct Summary {
+  long n = 0;
+  double min = 0;
+  double max = 0;
+  double mean = 0;
+  double m2 = 0, m3 = 0, m4 = 0; // Sums of squared/cubed/fourth power deviations from the mean
+  double variance() const {return n > 0 ? m2/n : 0;} // Population variance, same convention as stdev
+  double stdev() const;
+  double skewness() const;
+  double kurtosis() const; // Excess kurtosis, 0 for a normal distribution
+};
+
+Summary summarise(const std::vector<double> &data, int nThreads = 0); // min, max and moments in one parallel pass
+Summary merge_summary(const Summary &a, const Summary &b); // Combine the summaries of two disjoint samples
+std::array<int,2> data_range(const Summary &summary);
+std::array<int,2> data_range(const std::vector<double> &);
+double get_mean(const std::vector<double> &);
+double stdev(const std::vector<double> &, double);
\ No newline at end of file
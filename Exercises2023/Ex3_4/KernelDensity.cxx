@@ -0,0 +1,97 @@
+/**
+ * @file KernelDensity.cxx
+ * @author Kierran Falloon (kierran.falloon@strath.ac.uk)
+ * @date 05-12-2023
+ */
+
+#include <algorithm>
+#include <cmath>
+#include "KernelDensity.h"
+#include "HelperFunctions.h"
+#include "QuantileSketch.h"
+#include "Parallel.h"
+
+// Iterative Cooley-Tukey: bit reversal permutation, then log2(n) butterfly passes
+void fft(std::vector< std::complex<double> > &a, bool inverse) {
+  const int n = a.size();
+  for (int i = 1, j = 0; i < n; i++) {
+    int bit = n >> 1;
+    for (; j & bit; bit >>= 1) j ^= bit;
+    j ^= bit;
+    if (i < j) std::swap(a[i], a[j]);
+  }
+  for (int len = 2; len <= n; len <<= 1) {
+    double angle = 2*M_PI/len * (inverse ? 1 : -1);
+    std::complex<double> step(cos(angle), sin(angle));
+    for (int i = 0; i < n; i += len) {
+      std::complex<double> w(1.0, 0.0);
+      for (int k = 0; k < len/2; k++) {
+        std::complex<double> u = a[i+k];
+        std::complex<double> v = a[i+k+len/2]*w;
+        a[i+k] = u + v;
+        a[i+k+len/2] = u - v;
+        w *= step;
+      }
+    }
+  }
+  if (inverse) {
+    for (auto &x : a) x /= n;
+  }
+}
+
+double silverman_bandwidth(const std::vector<double> &points) {
+  Summary stats = summarise(points);
+  QuantileSketch sketch = sketch_data(points);
+  double iqr = sketch.quantile(0.75) - sketch.quantile(0.25);
+  double spread = (iqr > 0) ? std::min(stats.stdev(), iqr/1.34) : stats.stdev();
+  return 0.9 * spread * pow((double)std::max(stats.n, 1L), -0.2);
+}
+
+std::vector< std::pair<double,double> > kde(const std::vector<double> &points, double min, double max, int gridSize, double bandwidth, int nThreads) {
+  std::vector< std::pair<double,double> > density;
+  if (points.empty() || gridSize < 2) return density;
+  const double h = bandwidth > 0 ? bandwidth : silverman_bandwidth(points);
+  const double dx = (max - min)/(gridSize - 1);
+
+  // The binning grid extends 4h past each end so mass from just outside the range still reaches the edges
+  const int L = std::max(1, (int)std::ceil(4*h/dx));
+  const int S = gridSize + 2*L;
+  const double gridMin = min - L*dx;
+  int P = 1;
+  while (P < S) P <<= 1; // Reading only the central part means circular wrap never reaches the output
+
+  // Linear binning, each thread fills its own grid and they're summed afterwards
+  std::vector< std::vector<double> > partial(thread_count(nThreads));
+  parallel_for(points.size(), [&](long begin, long end, int c) {
+    std::vector<double> &counts = partial[c];
+    counts.assign(S, 0.0);
+    for (long i = begin; i < end; i++) {
+      double u = (points[i] - gridMin)/dx;
+      if (!(u >= 0) || u >= S - 1) continue;
+      int j = (int)u;
+      double frac = u - j;
+      counts[j] += 1 - frac;
+      counts[j+1] += frac;
+    }
+  }, nThreads);
+
+  std::vector< std::complex<double> > signal(P, 0.0), kernel(P, 0.0);
+  for (auto &counts : partial) {
+    for (int j = 0; j < counts.size(); j++) signal[j] += counts[j];
+  }
+  // Gaussian sampled on the grid, negative offsets wrapped to the end of the array
+  const double norm = 1/(h*sqrt(2*M_PI)*points.size());
+  for (int j = -L; j <= L; j++) {
+    double t = j*dx/h;
+    kernel[(j + P) % P] = norm*exp(-0.5*t*t);
+  }
+
+  fft(signal);
+  fft(kernel);
+  for (int k = 0; k < P; k++) signal[k] *= kernel[k];
+  fft(signal, true);
+
+  density.reserve(gridSize);
+  for (int i = 0; i < gridSize; i++) density.push_back({min + i*dx, std::max(0.0, signal[L + i].real())});
+  return density;
+}
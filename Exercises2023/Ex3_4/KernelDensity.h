@@ -0,0 +1,18 @@
+/**
+ * @file KernelDensity.h
+ * @author Kierran Falloon (kierran.falloon@strath.ac.uk)
+ * @date 05-12-2023
+ */
+
+#include <complex>
+#include <utility>
+#include <vector>
+
+#pragma once
+
+// Binned Gaussian kernel density estimate: the points are linearly binned onto a fine grid, which is then convolved
+// with the kernel by FFT. Cost is O(n + m log m) for n points and m grid points instead of O(n*m).
+// bandwidth <= 0 uses Silverman's rule. Returns (x, density) pairs on gridSize points spanning [min, max].
+std::vector< std::pair<double,double> > kde(const std::vector<double> &points, double min, double max, int gridSize = 1024, double bandwidth = 0, int nThreads = 0);
+double silverman_bandwidth(const std::vector<double> &points); // 0.9 * min(sd, IQR/1.34) * n^(-1/5)
+void fft(std::vector< std::complex<double> > &a, bool inverse = false); // In place radix-2 FFT, size must be a power of 2
@@ -0,0 +1,59 @@
+/**
+ * @file Parallel.h
+ * @author Kierran Falloon (kierran.falloon@strath.ac.uk)
+ * @date 05-12-2023
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#pragma once
+
+// Number of worker threads to use, nThreads <= 0 means one per hardware thread
+inline int thread_count(int nThreads = 0) {
+  if (nThreads > 0) return nThreads;
+  int hw = static_cast<int>(std::thread::hardware_concurrency());
+  return hw > 0 ? hw : 1;
+}
+
+// SplitMix64 of (seed, index), so neighbouring blocks, replicates or streams get unrelated generator states
+inline std::uint64_t stream_seed(std::uint64_t seed, std::uint64_t index) {
+  std::uint64_t z = seed + (index + 1) * 0x9E3779B97F4A7C15ULL;
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+// Split [0, n) into nThreads contiguous chunks and call body(begin, end, chunk) for each one.
+// Chunks smaller than minChunk are merged so tiny loops don't pay for thread start-up.
+template <typename F>
+void parallel_for(long n, F body, int nThreads = 0, long minChunk = 4096) {
+  if (n <= 0) return;
+  long maxChunks = std::max(1L, n / std::max(1L, minChunk));
+  int nChunks = static_cast<int>(std::min<long>(thread_count(nThreads), maxChunks));
+  if (nChunks == 1) { // Don't spawn anything for a single chunk
+    body(0L, n, 0);
+    return;
+  }
+  std::vector<std::thread> workers;
+  workers.reserve(nChunks - 1);
+  for (int c = 1; c < nChunks; c++) {
+    long begin = n * c / nChunks;
+    long end = n * (c + 1) / nChunks;
+    workers.emplace_back([&body, begin, end, c]() { body(begin, end, c); });
+  }
+  body(0L, n / nChunks, 0); // Calling thread takes the first chunk
+  for (std::thread &worker : workers) worker.join();
+}
+
+// Sum body(begin, end) over chunks of [0, n). Partial sums are added in chunk order so results are reproducible.
+template <typename F>
+double parallel_sum(long n, F body, int nThreads = 0, long minChunk = 4096) {
+  std::vector<double> partial(thread_count(nThreads), 0.0);
+  parallel_for(n, [&](long begin, long end, int c) { partial[c] = body(begin, end); }, nThreads, minChunk);
+  double sum = 0;
+  for (double p : partial) sum += p;
+  return sum;
+}
@@ -0,0 +1,185 @@
+/**
+ * @file PlotQueue.cxx
+ * @author Kierran Falloon (kierran.falloon@strath.ac.uk)
+ * @date 05-12-2023
+ */
+
+#include <iostream>
+#include <signal.h>
+#include <cmath>
+#include <algorithm>
+#include "PlotQueue.h"
+
+#include "gnuplot-iostream.h" //Needed to produce plots (not part of the course) 
+
+void generate_plot(const PlotJob &job, Gnuplot &gp);
+
+/*
+###################
+//Queue
+###################
+*/
+
+PlotQueue& PlotQueue::instance(){
+  static PlotQueue queue; //Destroyed (and so drained) after main returns
+  return queue;
+}
+
+PlotQueue::PlotQueue(){
+  m_Worker = std::thread(&PlotQueue::work, this);
+}
+
+PlotQueue::~PlotQueue(){
+  this->drain();
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Stop = true;
+  }
+  m_Wake.notify_all();
+  m_Worker.join();
+}
+
+void PlotQueue::push(PlotJob job){
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    if (m_Headless) return;
+    m_Jobs.push_back(std::move(job));
+  }
+  m_Wake.notify_one();
+}
+
+void PlotQueue::drain(){
+  std::unique_lock<std::mutex> lock(m_Mutex);
+  m_Idle.wait(lock, [this]() {return m_Jobs.empty() && !m_Busy;});
+}
+
+void PlotQueue::setHeadless(bool headless){
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  m_Headless = headless;
+  if (headless) m_Jobs.clear(); //Anything already queued is dropped too
+  m_Idle.notify_all();
+}
+
+//Take jobs off the front of the queue one at a time, each gets its own gnuplot process
+void PlotQueue::work(){
+  //A missing or crashed gnuplot shouldn't take the analysis down with it. SIGPIPE from a write is sent to the writing
+  //thread, so blocking it here turns those writes into errors without touching the process wide handler.
+  sigset_t pipe;
+  sigemptyset(&pipe);
+  sigaddset(&pipe, SIGPIPE);
+  pthread_sigmask(SIG_BLOCK, &pipe, nullptr);
+  while (true){
+    PlotJob job;
+    {
+      std::unique_lock<std::mutex> lock(m_Mutex);
+      m_Wake.wait(lock, [this]() {return m_Stop || !m_Jobs.empty();});
+      if (m_Jobs.empty()) return; //Only reached once stopping
+      job = std::move(m_Jobs.front());
+      m_Jobs.pop_front();
+      m_Busy = true;
+    }
+    try {
+      Gnuplot gp; //Set up gnuplot object
+      generate_plot(job, gp); //Generate the plot and save it to a png using the job name
+    }
+    catch (std::exception &e) {
+      std::cout << "Could not draw plot " << job.name << ": " << e.what() << std::endl;
+    }
+    {
+      std::lock_guard<std::mutex> lock(m_Mutex);
+      m_Busy = false;
+    }
+    m_Idle.notify_all();
+  }
+}
+
+/*
+###################
+//Plotting
+###################
+*/
+
+// Largest-Triangle-Three-Buckets: keep the first and last points, and from each of the (threshold-2) buckets in between
+// keep the point making the largest triangle with the previously kept point and the next bucket's average.
+std::vector< std::pair<double,double> > lttb(const std::vector< std::pair<double,double> > &points, int threshold){
+  const int n = points.size();
+  if (threshold < 3 || n <= threshold) return points;
+
+  std::vector< std::pair<double,double> > sampled;
+  sampled.reserve(threshold);
+  sampled.push_back(points[0]);
+  const double every = (double)(n - 2)/(threshold - 2); //Bucket size
+  int a = 0; //Index of the last kept point
+
+  for (int i = 0; i < threshold - 2; i++){
+    //Average of the next bucket, the third vertex of the triangle
+    int nextStart = (int)((i + 1)*every) + 1;
+    int nextEnd = std::min((int)((i + 2)*every) + 1, n);
+    double avgX = points[n-1].first, avgY = points[n-1].second; //Last bucket just uses the final point
+    if (nextEnd > nextStart){
+      avgX = 0;
+      avgY = 0;
+      for (int j = nextStart; j < nextEnd; j++){
+        avgX += points[j].first;
+        avgY += points[j].second;
+      }
+      avgX /= (nextEnd - nextStart);
+      avgY /= (nextEnd - nextStart);
+    }
+
+    //Point in this bucket with the largest triangle area
+    int start = (int)(i*every) + 1;
+    int end = (int)((i + 1)*every) + 1;
+    double maxArea = -1;
+    int chosen = start;
+    for (int j = start; j < end; j++){
+      double area = std::abs((points[a].first - avgX)*(points[j].second - points[a].second) - (points[a].first - points[j].first)*(avgY - points[a].second));
+      if (area > maxArea){
+        maxArea = area;
+        chosen = j;
+      }
+    }
+    sampled.push_back(points[chosen]);
+    a = chosen;
+  }
+  sampled.push_back(points[n-1]);
+  return sampled;
+}
+
+//Function which handles generating the gnuplot output for a queued job, called on the worker thread
+//Each non-empty series gets a plot clause, then the points are streamed as raw doubles in the same order
+//SUPACPP note: They syntax of the plotting code is not part of the course
+void generate_plot(const PlotJob &job, Gnuplot &gp){
+
+  std::vector<const std::vector< std::pair<double,double> >*> series;
+  std::vector<std::string> styles;
+  bool onlyFunction = job.plotfunction && !job.plotdatapoints && !job.plotsamplepoints && !job.plotkde;
+  if (job.plotfunction){
+    series.push_back(&job.function_scan);
+    styles.push_back("with linespoints ls 1 title '" + (onlyFunction ? std::string("function") : job.name) + "'");
+  }
+  if (job.plotsamplepoints){
+    series.push_back(&job.samples);
+    styles.push_back("with points ps 2 lc rgb 'blue' title 'sampled data'");
+  }
+  if (job.plotdatapoints){
+    series.push_back(&job.data);
+    styles.push_back("with points ps 1 lc rgb 'black' pt 7 title 'data'");
+  }
+  if (job.plotkde){
+    series.push_back(&job.kde);
+    styles.push_back("with lines lw 2 lc rgb 'red' title 'data KDE'");
+  }
+  if (series.empty()) return;
+
+  gp << "set terminal pngcairo\n";
+  gp << "set output 'Outputs/png/"<<job.name<<".png'\n"; 
+  gp << "set xrange ["<<job.rmin<<":"<<job.rmax<<"]\n";
+  if (job.plotfunction) gp << "set style line 1 lt 1 lw 2 pi 1 ps 0\n";
+  gp << "plot ";
+  for (int i = 0; i < series.size(); i++){
+    gp << (i ? ", " : "") << "'-' binary" << gp.binFmt1d(*series[i], "record") << styles[i];
+  }
+  gp << "\n";
+  for (const auto* points : series) gp.sendBinary1d(*points);
+}
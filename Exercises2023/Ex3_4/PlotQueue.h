@@ -0,0 +1,63 @@
+/**
+ * @file PlotQueue.h
+ * @author Kierran Falloon (kierran.falloon@strath.ac.uk)
+ * @date 05-12-2023
+ */
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#pragma once
+
+// Immutable copy of everything needed to draw one FiniteFunction plot
+struct PlotJob {
+  std::string name; //Output png stem and function title
+  double rmin;
+  double rmax;
+  std::vector< std::pair<double,double> > function_scan;
+  std::vector< std::pair<double,double> > samples;
+  std::vector< std::pair<double,double> > data;
+  std::vector< std::pair<double,double> > kde;
+  bool plotfunction = false;
+  bool plotdatapoints = false;
+  bool plotsamplepoints = false;
+  bool plotkde = false;
+};
+
+const int plot_points = 1280; //pngcairo draws 640 px wide, two points per pixel keeps the shape of any line
+
+// Shape preserving decimation (Largest-Triangle-Three-Buckets) of an x-sorted series down to threshold points
+std::vector< std::pair<double,double> > lttb(const std::vector< std::pair<double,double> > &points, int threshold);
+
+// Single background worker that feeds queued plots to gnuplot, so rendering never blocks the analysis.
+// The queue is drained when the program exits, or immediately with drain().
+// SIGPIPE is blocked on the worker thread only (a missing or crashed gnuplot gives a write error there rather than
+// killing the process); the rest of the process keeps its own signal handling.
+class PlotQueue{
+
+public:
+  static PlotQueue& instance(); //Process wide queue, the worker starts on first use
+  ~PlotQueue(); //Drains outstanding jobs then stops the worker
+  void push(PlotJob job); //Queue a plot (dropped in headless mode)
+  void drain(); //Block until every queued plot has been drawn
+  void setHeadless(bool headless); //Skip rendering entirely, e.g. on machines without gnuplot
+  bool headless() {return m_Headless;}; //Atomic, so it can be read without the lock
+
+private:
+  PlotQueue();
+  void work(); //Worker loop
+  std::deque<PlotJob> m_Jobs;
+  std::mutex m_Mutex;
+  std::condition_variable m_Wake; //Signals the worker that there is a job or it should stop
+  std::condition_variable m_Idle; //Signals drain() that the queue is empty and nothing is being drawn
+  bool m_Busy = false; //Worker is drawing a job
+  bool m_Stop = false;
+  std::atomic<bool> m_Headless{false}; //Written under m_Mutex together with the queue
+  std::thread m_Worker;
+};
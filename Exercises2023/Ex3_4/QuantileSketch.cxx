@@ -0,0 +1,143 @@
+/**
+ * @file QuantileSketch.cxx
+ * @author Kierran Falloon (kierran.falloon@strath.ac.uk)
+ * @date 05-12-2023
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+#include "QuantileSketch.h"
+#include "Parallel.h"
+
+QuantileSketch::QuantileSketch(int k, std::uint64_t seed) : m_Gen(seed) {
+  m_K = std::max(k, 8);
+  m_Min = std::numeric_limits<double>::infinity();
+  m_Max = -std::numeric_limits<double>::infinity();
+  this->grow();
+}
+
+//Upper levels get the full k, each level below gets 2/3 of the one above (at least 2)
+int QuantileSketch::capacity(int level) const {
+  int depth = m_Levels.size() - level - 1;
+  return static_cast<int>(std::ceil(pow(2.0/3.0, depth) * m_K)) + 1;
+}
+
+void QuantileSketch::grow() {
+  m_Levels.emplace_back();
+  m_MaxStored = 0;
+  for (int h = 0; h < m_Levels.size(); h++) m_MaxStored += this->capacity(h);
+}
+
+void QuantileSketch::add(double x) {
+  m_Count++;
+  m_Min = std::min(m_Min, x);
+  m_Max = std::max(m_Max, x);
+  m_Levels[0].push_back(x);
+  if (++m_Stored >= m_MaxStored) this->compress();
+}
+
+void QuantileSketch::add(const std::vector<double> &values) {
+  for (double x : values) this->add(x);
+}
+
+//Compact the lowest overfull level: sort it, keep every other value (random parity) and move them up a level
+void QuantileSketch::compress() {
+  for (int h = 0; h < m_Levels.size(); h++) {
+    if (m_Levels[h].size() < this->capacity(h)) continue;
+    if (h+1 == m_Levels.size()) this->grow();
+    std::vector<double> &level = m_Levels[h];
+    std::sort(level.begin(), level.end());
+    double leftover = 0;
+    bool odd = level.size() % 2;
+    if (odd) { //An odd value out stays at this level
+      leftover = level.back();
+      level.pop_back();
+    }
+    int offset = m_Gen() & 1;
+    for (int i = offset; i < level.size(); i += 2) m_Levels[h+1].push_back(level[i]);
+    level.clear();
+    if (odd) level.push_back(leftover);
+
+    m_Stored = 0;
+    for (auto &l : m_Levels) m_Stored += l.size();
+    if (m_Stored < m_MaxStored) break;
+  }
+}
+
+void QuantileSketch::merge(const QuantileSketch &other) {
+  while (m_Levels.size() < other.m_Levels.size()) this->grow();
+  for (int h = 0; h < other.m_Levels.size(); h++) {
+    m_Levels[h].insert(m_Levels[h].end(), other.m_Levels[h].begin(), other.m_Levels[h].end());
+  }
+  m_Count += other.m_Count;
+  m_Min = std::min(m_Min, other.m_Min);
+  m_Max = std::max(m_Max, other.m_Max);
+  m_Stored = this->size();
+  while (m_Stored >= m_MaxStored) {
+    int before = m_Stored;
+    this->compress();
+    if (m_Stored == before) break; //Nothing overfull
+  }
+}
+
+int QuantileSketch::size() const {
+  int n = 0;
+  for (auto &l : m_Levels) n += l.size();
+  return n;
+}
+
+//Weighted rank lookup over every stored value
+double QuantileSketch::quantile(double q) const {
+  if (m_Count == 0) return std::numeric_limits<double>::quiet_NaN();
+  if (q <= 0) return m_Min;
+  if (q >= 1) return m_Max;
+  std::vector< std::pair<double,double> > weighted; //(value, weight)
+  double total = 0;
+  for (int h = 0; h < m_Levels.size(); h++) {
+    for (double x : m_Levels[h]) weighted.push_back({x, (double)(1L << h)});
+    total += m_Levels[h].size() * (double)(1L << h);
+  }
+  std::sort(weighted.begin(), weighted.end());
+  double target = q*total, cumulative = 0;
+  for (auto &w : weighted) {
+    cumulative += w.second;
+    if (cumulative >= target) return w.first;
+  }
+  return m_Max;
+}
+
+/*
+###################
+//Helpers
+###################
+*/
+
+QuantileSketch sketch_data(const std::vector<double> &data, int nThreads, int k) {
+  std::vector<QuantileSketch> partial(thread_count(nThreads), QuantileSketch(k));
+  parallel_for(data.size(), [&](long begin, long end, int c) {
+    partial[c] = QuantileSketch(k, c+1); //Different compaction coin per thread
+    for (long i = begin; i < end; i++) partial[c].add(data[i]);
+  }, nThreads);
+  QuantileSketch total = partial[0];
+  for (int c = 1; c < partial.size(); c++) total.merge(partial[c]);
+  return total;
+}
+
+//Cut at the outer fences so a handful of outliers don't stretch every histogram. Only the quartiles are needed,
+//which the sketch knows far better than the extreme tails, and the range never extends past the data itself.
+std::array<double,2> trimmed_range(const QuantileSketch &sketch, double fence) {
+  double q1 = sketch.quantile(0.25), q3 = sketch.quantile(0.75);
+  double lo = std::max(sketch.min(), q1 - fence*(q3 - q1));
+  double hi = std::min(sketch.max(), q3 + fence*(q3 - q1));
+  double pad = 0.01*(hi - lo); //Keep the edge points inside the last bins
+  return {lo - pad, hi + pad};
+}
+
+int fd_bins(const QuantileSketch &sketch, double min, double max) {
+  double iqr = sketch.quantile(0.75) - sketch.quantile(0.25);
+  if (!(iqr > 0) || sketch.count() == 0) return 50; //Degenerate data, fall back to the usual 50
+  double width = 2*iqr/cbrt((double)sketch.count());
+  return std::clamp(static_cast<int>(std::ceil((max - min)/width)), 1, 10000);
+}
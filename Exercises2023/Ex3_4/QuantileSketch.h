@@ -0,0 +1,47 @@
+/**
+ * @file QuantileSketch.h
+ * @author Kierran Falloon (kierran.falloon@strath.ac.uk)
+ * @date 05-12-2023
+ */
+
+#include <array>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#pragma once
+
+// KLL streaming quantile sketch (Karnin, Lang & Liberty 2016). Values go into a stack of compactors, and whenever the
+// sketch is full the lowest overfull level is sorted and every other value is promoted with double the weight.
+// Memory stays at roughly 3k values whatever the stream length, the rank error is about 1.7/k, and two sketches of
+// disjoint streams merge into a sketch of the combined stream, so threads or files can be sketched separately.
+class QuantileSketch{
+
+public:
+  QuantileSketch(int k = 200, std::uint64_t seed = 1);
+  void add(double x); //Feed one value
+  void add(const std::vector<double> &values);
+  void merge(const QuantileSketch &other); //Absorb another sketch (same k)
+  double quantile(double q) const; //Approximate q-quantile, q in [0, 1]
+  long count() const {return m_Count;};
+  double min() const {return m_Min;};
+  double max() const {return m_Max;};
+  int size() const; //Values currently stored
+
+private:
+  int m_K;
+  long m_Count = 0;
+  double m_Min, m_Max; //Exact extremes, kept separately
+  int m_Stored = 0;
+  int m_MaxStored = 0;
+  std::vector< std::vector<double> > m_Levels; //Level h holds values of weight 2^h
+  std::mt19937_64 m_Gen; //Picks odd or even survivors when compacting
+  int capacity(int level) const;
+  void grow();
+  void compress();
+};
+
+QuantileSketch sketch_data(const std::vector<double> &data, int nThreads = 0, int k = 200); //Per-thread sketches merged
+std::array<double,2> trimmed_range(const QuantileSketch &sketch, double fence = 3.0); //Tukey fences [Q1 - fence*IQR, Q3 + fence*IQR] clipped to the data
+int fd_bins(const QuantileSketch &sketch, double min, double max); //Freedman-Diaconis: bin width 2*IQR/n^(1/3)
@@ -0,0 +1,185 @@
+/**
+ * @file QuasiMonteCarlo.cxx
+ * @author Kierran Falloon (kierran.falloon@strath.ac.uk)
+ * @date 05-12-2023
+ */
+
+#include <iostream>
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+#include <random>
+#include "QuasiMonteCarlo.h"
+#include "Parallel.h"
+
+/*
+###################
+//Sequences
+###################
+*/
+
+// Joe & Kuo (new-joe-kuo-6.21201) primitive polynomials for dimensions 2-10: degree s, coefficients a, initial m_1..m_s
+struct SobolPolynomial {int s; int a; int m[5];};
+static const SobolPolynomial sobol_polynomials[qmc_max_dim - 1] = {
+  {1, 0, {1}}, {2, 1, {1, 3}}, {3, 1, {1, 3, 1}}, {3, 2, {1, 1, 1}}, {4, 1, {1, 1, 3, 3}},
+  {4, 4, {1, 3, 5, 13}}, {5, 2, {1, 1, 5, 5, 17}}, {5, 4, {1, 1, 5, 5, 5}}, {5, 7, {1, 1, 7, 11, 19}}
+};
+static const int halton_bases[qmc_max_dim] = {2, 3, 5, 7, 11, 13, 17, 19, 23, 29};
+
+static std::uint32_t reverse_bits(std::uint32_t x) {
+  x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+  x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+  x = ((x >> 4) & 0x0F0F0F0Fu) | ((x & 0x0F0F0F0Fu) << 4);
+  x = ((x >> 8) & 0x00FF00FFu) | ((x & 0x00FF00FFu) << 8);
+  return (x >> 16) | (x << 16);
+}
+
+// Nested uniform (Owen) scrambling of a 32 bit fraction by hashing (Burley 2020): each bit is flipped depending only
+// on the bits above it, which keeps the digital net structure while making every point uniformly distributed
+static std::uint32_t owen_scramble(std::uint32_t x, std::uint32_t seed) {
+  x = reverse_bits(x);
+  x += seed;
+  x ^= x * 0x6c50b47cu;
+  x ^= x * 0xb82f1e52u;
+  x ^= x * 0xc7afe638u;
+  x ^= x * 0x8d22f6e6u;
+  return reverse_bits(x);
+}
+
+PointSet::PointSet(Sequence sequence, int dim, std::uint64_t seed) {
+  if (dim < 1 || (sequence != Sequence::MonteCarlo && dim > qmc_max_dim)) {
+    std::cout << "Quasi-Monte Carlo sequences are only tabulated up to " << qmc_max_dim << " dimensions, got " << dim << std::endl;
+    exit(1);
+  }
+  m_Sequence = sequence;
+  m_Dim = dim;
+  m_Seed = seed;
+  std::mt19937_64 gen(stream_seed(seed, 0));
+
+  if (sequence == Sequence::Sobol) {
+    m_Directions.resize(32*dim);
+    for (int k = 0; k < 32; k++) m_Directions[k] = 1u << (31 - k); // First dimension is van der Corput
+    for (int d = 1; d < dim; d++) {
+      const SobolPolynomial &p = sobol_polynomials[d-1];
+      std::uint32_t* v = &m_Directions[32*d];
+      for (int k = 0; k < p.s; k++) v[k] = p.m[k] << (31 - k);
+      for (int k = p.s; k < 32; k++) {
+        v[k] = v[k - p.s] ^ (v[k - p.s] >> p.s);
+        for (int i = 1; i < p.s; i++) {
+          if ((p.a >> (p.s - 1 - i)) & 1) v[k] ^= v[k - i];
+        }
+      }
+    }
+    for (int d = 0; d < dim; d++) m_Scramble.push_back(static_cast<std::uint32_t>(gen()));
+  }
+  else if (sequence == Sequence::Halton) {
+    // Independent random permutation of the digits at every position, down to double precision
+    for (int d = 0; d < dim; d++) {
+      int b = halton_bases[d];
+      int nDigits = std::ceil(53/std::log2(b));
+      std::vector<int> perms(nDigits*b);
+      for (int p = 0; p < nDigits; p++) {
+        std::iota(perms.begin() + p*b, perms.begin() + (p+1)*b, 0);
+        std::shuffle(perms.begin() + p*b, perms.begin() + (p+1)*b, gen);
+      }
+      std::vector<double> tail(nDigits + 1, 0.0);
+      for (int p = nDigits - 1; p >= 0; p--) tail[p] = tail[p+1] + perms[p*b]*std::pow(b, -(p + 1));
+      m_Perms.push_back(perms);
+      m_Tails.push_back(tail);
+    }
+  }
+}
+
+void PointSet::generate(long first, int n, double* u) const {
+  if (m_Sequence == Sequence::Sobol) {
+    const double scale = 1.0/4294967296.0; // 2^-32
+    std::uint32_t x[qmc_max_dim];
+    std::uint32_t index = first;
+    for (int d = 0; d < m_Dim; d++) { // Full XOR for the first point only
+      const std::uint32_t* v = &m_Directions[32*d];
+      x[d] = 0;
+      for (std::uint32_t bits = index, k = 0; bits; bits >>= 1, k++) {
+        if (bits & 1) x[d] ^= v[k];
+      }
+    }
+    for (int i = 0; i < n; i++, index++) {
+      for (int d = 0; d < m_Dim; d++) u[i*m_Dim + d] = (owen_scramble(x[d], m_Scramble[d]) + 0.5)*scale;
+      // index -> index+1 flips the trailing ones and the zero above them, on average two direction numbers
+      for (std::uint32_t flipped = index ^ (index + 1), k = 0; flipped; flipped >>= 1, k++) {
+        for (int d = 0; d < m_Dim; d++) x[d] ^= m_Directions[32*d + k];
+      }
+    }
+  }
+  else if (m_Sequence == Sequence::Halton) {
+    for (int d = 0; d < m_Dim; d++) {
+      const int b = halton_bases[d];
+      const std::vector<int> &perms = m_Perms[d];
+      const std::vector<double> &tail = m_Tails[d];
+      for (int i = 0; i < n; i++) {
+        long index = first + i;
+        double value = 0, weight = 1.0/b;
+        int p = 0;
+        for (; index > 0; p++) {
+          value += perms[p*b + index % b]*weight;
+          index /= b;
+          weight /= b;
+        }
+        u[i*m_Dim + d] = value + tail[p]; // Positions past the last digit of index all contribute perm(0)
+      }
+    }
+  }
+  else { // Pseudo-random, seeded from the first index so each block is reproducible on its own
+    std::mt19937_64 gen(stream_seed(m_Seed, first));
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    for (int i = 0; i < n*m_Dim; i++) u[i] = uniform(gen);
+  }
+}
+
+/*
+###################
+//Integration
+###################
+*/
+
+QMCResult qmc_integrate(const BatchIntegrand &f, int dim, double tolerance, Sequence sequence, int nReplicates, long maxPoints, std::uint64_t seed, int nThreads) {
+  const int block = 1024;
+  nReplicates = std::max(2, nReplicates);
+  std::vector<PointSet> sets;
+  for (int r = 0; r < nReplicates; r++) sets.emplace_back(sequence, dim, stream_seed(seed, r));
+
+  std::vector<double> sums(nReplicates, 0.0); // Running sum of f over each replicate's points
+  QMCResult result{0, 0, 0, nReplicates, false};
+  long n = 0, next = 4*block; // Powers of two keep the Sobol points a complete net
+
+  while (true) {
+    // Blocks [n, next) of every replicate, replicate-major so the sums can be added back in order
+    long blocksPerReplicate = (next - n)/block;
+    long nBlocks = blocksPerReplicate*nReplicates;
+    std::vector<double> blockSums(nBlocks, 0.0);
+    parallel_for(nBlocks, [&](long begin, long end, int) {
+      std::vector<double> u(block*dim), out(block);
+      for (long j = begin; j < end; j++) {
+        int r = j / blocksPerReplicate;
+        long first = n + (j % blocksPerReplicate)*block;
+        sets[r].generate(first, block, u.data());
+        f(u.data(), block, out.data());
+        double sum = 0;
+        for (int i = 0; i < block; i++) sum += out[i];
+        blockSums[j] = sum;
+      }
+    }, nThreads, 1);
+    for (long j = 0; j < nBlocks; j++) sums[j / blocksPerReplicate] += blockSums[j];
+    n = next;
+
+    double mean = 0, var = 0;
+    for (double s : sums) mean += s/n/nReplicates;
+    for (double s : sums) var += (s/n - mean)*(s/n - mean)/(nReplicates - 1);
+    result.value = mean;
+    result.error = sqrt(var/nReplicates);
+    result.nPoints = n;
+    result.converged = result.error <= tolerance*std::abs(mean);
+    if (result.converged || 2*n > maxPoints) break;
+    next = 2*n;
+  }
+  return result;
+}
@@ -0,0 +1,49 @@
+/**
+ * @file QuasiMonteCarlo.h
+ * @author Kierran Falloon (kierran.falloon@strath.ac.uk)
+ * @date 05-12-2023
+ */
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#pragma once
+
+enum class Sequence {MonteCarlo, Sobol, Halton};
+const int qmc_max_dim = 10; // Sobol direction numbers and Halton bases are tabulated up to this many dimensions
+
+// Integrand over the unit cube, called with n points as an n*dim row-major array and filling out[0..n)
+typedef std::function<void(const double* u, int n, double* out)> BatchIntegrand;
+
+struct QMCResult {
+  double value; // Mean over the randomised replicates
+  double error; // Standard error from the spread of the replicates
+  long nPoints; // Points used per replicate
+  int nReplicates;
+  bool converged; // error <= tolerance*|value| before maxPoints was reached
+};
+
+// Randomised (quasi-)Monte Carlo integral of f over [0,1)^dim.
+// nReplicates independent randomisations (Owen scrambled Sobol, random digit permuted Halton, or independent
+// pseudo-random streams) are each extended in doubling rounds until the standard error between them drops below
+// tolerance*|value|. Each round is cut into blocks of 1024 points that are generated and evaluated in parallel,
+// and the block sums are added in a fixed order, so the result doesn't depend on nThreads.
+QMCResult qmc_integrate(const BatchIntegrand &f, int dim, double tolerance = 1e-6, Sequence sequence = Sequence::Sobol, int nReplicates = 8, long maxPoints = 1L << 22, std::uint64_t seed = 1, int nThreads = 0);
+
+// Fill u (n*dim) with points first..first+n-1 of one randomisation of a sequence
+class PointSet{
+
+public:
+  PointSet(Sequence sequence, int dim, std::uint64_t seed);
+  void generate(long first, int n, double* u) const;
+
+private:
+  Sequence m_Sequence;
+  int m_Dim;
+  std::uint64_t m_Seed;
+  std::vector<std::uint32_t> m_Directions; // Sobol: 32 direction numbers per dimension
+  std::vector<std::uint32_t> m_Scramble; // Sobol: one Owen scrambling seed per dimension
+  std::vector< std::vector<int> > m_Perms; // Halton: per dimension, a random digit permutation for each digit position
+  std::vector< std::vector<double> > m_Tails; // Halton: per dimension, sum of perm(0)*b^-(p+1) over positions p and above
+};
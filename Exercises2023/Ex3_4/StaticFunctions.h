@@ -0,0 +1,159 @@
+/**
+ * @file StaticFunctions.h
+ * @author Kierran Falloon (kierran.falloon@strath.ac.uk)
+ * @date 05-12-2023
+ *
+ * Value-type versions of the CustomFunctions distributions plus templated kernels that use them.
+ * Nothing here is virtual, so the compiler can inline the PDF into the integrate/scan/histogram/Metropolis loops.
+ * The FiniteFunction classes in CustomFunctions.h forward to these, so the formulas only live in one place.
+ */
+
+#include <cmath>
+#include <concepts>
+#include <random>
+#include <utility>
+#include <vector>
+#include "FiniteFunctions.h"
+
+#pragma once
+
+// Anything callable as f(x) -> double can go through the kernels below
+template <typename D>
+concept Density = requires(const D &d, double x) {
+  {d(x)} -> std::convertible_to<double>;
+};
+
+/*
+###################
+//Distributions
+// Parameter-dependent constants are worked out once in the constructor, so evaluation is just the x-dependent part
+###################
+*/
+
+struct NormalDensity {
+  double mu, sigma;
+  double invSigma, norm, logNorm;
+  NormalDensity(double mu = 0.0, double sigma = 1.0) : mu(mu), sigma(sigma) {
+    invSigma = 1/sigma;
+    norm = 1/(sigma*sqrt(2*M_PI));
+    logNorm = log(norm);
+  }
+  double operator()(double x) const {
+    double z = (x-mu)*invSigma;
+    return norm*exp(-0.5*z*z);
+  }
+  double logValue(double x) const {
+    double z = (x-mu)*invSigma;
+    return logNorm - 0.5*z*z;
+  }
+};
+
+struct CauchyLorentzDensity {
+  double x0, gamma;
+  double invGamma, norm, logNorm;
+  CauchyLorentzDensity(double x0 = 0.0, double gamma = 1.0) : x0(x0), gamma(gamma) {
+    invGamma = 1/gamma;
+    norm = 1/(M_PI*gamma);
+    logNorm = log(norm);
+  }
+  double operator()(double x) const {
+    double t = (x-x0)*invGamma;
+    return norm/(1 + t*t);
+  }
+  double logValue(double x) const {
+    double t = (x-x0)*invGamma;
+    return logNorm - log(1 + t*t);
+  }
+};
+
+struct NegativeCrystalBallDensity {
+  double xbar, sigma, alpha, n;
+  double invSigma, A, B, N, logN, logNA;
+  NegativeCrystalBallDensity(double xbar = 0.0, double sigma = 1.0, double alpha = 1.0, double n = 1.0) : xbar(xbar), sigma(sigma), alpha(std::abs(alpha)), n(n) {
+    double a = this->alpha;
+    A = pow(n/a, n) * exp(-a*a/2);
+    B = n/a - a;
+    double C = n/a * (1/(n-1)) * exp(-a*a/2);
+    double D = sqrt(M_PI/2) * (1 + erf(a/sqrt(2)));
+    N = 1/(sigma * (C+D));
+    invSigma = 1/sigma;
+    logN = log(N);
+    logNA = log(N*A);
+  }
+  double operator()(double x) const {
+    double z = (x-xbar)*invSigma;
+    return (z <= -alpha) ? N * A * pow(B-z, -n) : N * exp(-0.5*z*z);
+  }
+  double logValue(double x) const {
+    double z = (x-xbar)*invSigma;
+    return (z <= -alpha) ? logNA - n*log(B-z) : logN - 0.5*z*z;
+  }
+};
+
+// Wraps a FiniteFunction so the same kernels can be run through the virtual callFunction (e.g. to compare the two)
+struct VirtualDensity {
+  FiniteFunction* function;
+  double operator()(double x) const {return function->callFunction(x);}
+};
+
+/*
+###################
+//Kernels
+###################
+*/
+
+// Simpson's rule over [min, max], same scheme as FiniteFunction::integrate
+template <Density D>
+double integrate_density(const D &f, double min, double max, int Ndiv) {
+  double h = (max - min)/Ndiv;
+  double S_zero = f(min) + f(max), S_one = 0, S_two = 0;
+  for (int n = 1; n < Ndiv; n++) {
+    double fx = f(min + n*h);
+    if (n % 2 != 0) S_one += fx;
+    else S_two += fx;
+  }
+  return (h/3) * (S_zero + 4*S_one + 2*S_two);
+}
+
+// (x, f(x)/norm) pairs in the same layout as FiniteFunction::scanFunction
+template <Density D>
+std::vector< std::pair<double,double> > scan_density(const D &f, double min, double max, int Nscan, double norm = 1.0) {
+  std::vector< std::pair<double,double> > scan(Nscan);
+  double step = (max - min)/(double)Nscan;
+  double invNorm = 1/norm;
+  for (int i = 0; i < Nscan; i++) {
+    double x = min + i*step;
+    scan[i] = std::make_pair(x, f(x)*invNorm);
+  }
+  return scan;
+}
+
+// Integral of f over each of Nbins equal bins (Simpson with subDiv divisions per bin), i.e. the model histogram
+template <Density D>
+std::vector<double> hist_density(const D &f, double min, double max, int Nbins, int subDiv = 8) {
+  std::vector<double> bins(Nbins);
+  double width = (max - min)/Nbins;
+  for (int b = 0; b < Nbins; b++) bins[b] = integrate_density(f, min + b*width, min + (b+1)*width, subDiv);
+  return bins;
+}
+
+// Random-walk Metropolis: propose x + N(0, step), accept with min(1, f(y)/f(x)), zero density outside [min, max].
+// Every iteration records the current x, so the chain has exactly nSamples entries.
+template <Density D, typename RNG>
+std::vector<double> metropolis_density(const D &f, double min, double max, int nSamples, double step, double start, RNG &gen) {
+  std::vector<double> samples(nSamples);
+  std::normal_distribution<double> proposal(0.0, step);
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+  double x = start;
+  double fx = f(x);
+  for (int i = 0; i < nSamples; i++) {
+    double y = x + proposal(gen);
+    double fy = (y >= min && y <= max) ? f(y) : 0.0;
+    if (fy >= fx || uniform(gen)*fx < fy) {
+      x = y;
+      fx = fy;
+    }
+    samples[i] = x;
+  }
+  return samples;
+}
@@ -0,0 +1,60 @@
+/**
+ * @file Stats.h
+ * @author Kierran Falloon (kierran.falloon@strath.ac.uk)
+ * @date 05-12-2023
+ *
+ * Runtime counters for FiniteFunction objects, compiled in with -DFF_STATS (make STATS=1).
+ * Without FF_STATS the FF_STAT_* macros expand to nothing and FiniteFunction has no counter member, so a normal
+ * build does exactly the work it did before.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <string>
+
+#pragma once
+
+// Counters are relaxed atomics because callFunction is called from several threads at once (e.g. goodness of fit)
+struct FunctionStats {
+  std::atomic<long> calls{0}; // callFunction
+  std::atomic<long> logEvals{0}; // Points through logFunction
+  std::atomic<long> integrations{0}; // integrate() runs, i.e. integral() cache misses
+  std::atomic<long> integrationEvals{0}; // Function evaluations made by those runs
+  std::atomic<long> integralCacheHits{0};
+  std::atomic<long> scans{0}, scanPoints{0}; // scanFunction
+  std::atomic<long> histograms{0}, histogramFills{0}; // binData calls, points landing in a bin
+  std::atomic<long> proposals{0}, accepted{0}, rejected{0}; // MetropolisHastings samples of this function
+  std::atomic<long> integrateNs{0}, scanNs{0}, histogramNs{0}, samplingNs{0}; // Wall time inside each
+  std::string json(std::string name) const { // One JSON object with every counter
+    auto field = [](std::string key, long value) {return "  \"" + key + "\": " + std::to_string(value);};
+    return "{\n  \"function\": \"" + name + "\",\n" +
+      field("calls", calls) + ",\n" + field("logEvals", logEvals) + ",\n" +
+      field("integrations", integrations) + ",\n" + field("integrationEvals", integrationEvals) + ",\n" +
+      field("integralCacheHits", integralCacheHits) + ",\n" + field("integrateNs", integrateNs) + ",\n" +
+      field("scans", scans) + ",\n" + field("scanPoints", scanPoints) + ",\n" + field("scanNs", scanNs) + ",\n" +
+      field("histograms", histograms) + ",\n" + field("histogramFills", histogramFills) + ",\n" + field("histogramNs", histogramNs) + ",\n" +
+      field("proposals", proposals) + ",\n" + field("accepted", accepted) + ",\n" + field("rejected", rejected) + ",\n" +
+      field("samplingNs", samplingNs) + "\n}\n";
+  }
+  bool empty() const {return calls == 0 && logEvals == 0 && integrations == 0 && integralCacheHits == 0 && scans == 0 && histograms == 0 && proposals == 0;}
+};
+
+// Adds its own lifetime in nanoseconds to a counter
+class StatTimer{
+
+public:
+  StatTimer(std::atomic<long> &counter) : m_Counter(counter), m_Start(std::chrono::steady_clock::now()) {};
+  ~StatTimer() {m_Counter.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_Start).count(), std::memory_order_relaxed);};
+
+private:
+  std::atomic<long> &m_Counter;
+  std::chrono::steady_clock::time_point m_Start;
+};
+
+#ifdef FF_STATS
+#define FF_STAT_ADD(stats, counter, n) (stats).counter.fetch_add((n), std::memory_order_relaxed)
+#define FF_STAT_TIMER(stats, counter) StatTimer ff_stat_timer_##counter((stats).counter)
+#else
+#define FF_STAT_ADD(stats, counter, n) ((void)0)
+#define FF_STAT_TIMER(stats, counter) ((void)0)
+#endif
@@ -7,50 +7,131 @@
 
 #include "FiniteFunctions.h"
 #include <iostream>
+#include <algorithm>
+#include <cmath>
 #include "HelperFunctions.h"
 #include "CustomFunctions.h"
+#include "FitFunctions.h"
+#include "PlotQueue.h"
+#include "GoodnessOfFit.h"
+#include "GridScan.h"
+#include "ThreadPool.h"
+#include "Parallel.h"
+#include <string>
+#include <mutex>
 
+// Each model (fit + processFunction) is one task on a shared pool. Models only share the read-only data, write to
+// their own Outputs/ files, seed their own Metropolis chain and print their reports in whole blocks.
 template <typename T>
-void processFunction(T& function, std::vector<double>& data) {
+void processFunction(T& function, std::vector<double>& data, unsigned long seed, Progress& progress) {
   function.integral(1000); // Calculate integral using N intermediate sample points
   function.plotFunction(); // Plot function
-  function.plotData(data, 50, true); // Plot data
-  function.printInfo(); // Dump info
+  function.plotData(data, 0, true); // Plot data, Freedman-Diaconis bin count
+  function.plotKDE(data); // Smooth density estimate of the data
+  GoodnessOfFit gof = goodness_of_fit(&function, data); // KS, Anderson-Darling and Cramer-von Mises against the data
 
   // Get Metropolis-Hasings samples and plot them on the same graph
-  MetropolisHastings metropolisFunc(&function, 10000); // Create Metropolis func with nSample points
-  metropolisFunc.printInfo(); // Log info
-  
+  MetropolisHastings metropolisFunc(&function, 10000, seed); // Create Metropolis func with nSample points
   std::vector<double> metropolisData = metropolisFunc.sample(); // Gather samples 
   function.plotData(metropolisData, 100, false); // Plot sampled points
+  function.exportData(); // Write scan and histograms to Outputs/data/<name>.data
+
+  std::lock_guard<std::mutex> lock(progress.console());
+  function.printInfo(); // Dump info
+  print_gof(gof, "Model");
+  metropolisFunc.printInfo(); // Log info
+}
+
+// Print a fit result without interleaving with other models
+void report(const FitResult &result, std::string title, Progress& progress) {
+  std::lock_guard<std::mutex> lock(progress.console());
+  print_fit(result, title);
 }
 
-int main()
+int main(int argc, char *argv[])
 {
+  // Plots are drawn on a background thread and the program waits for them at exit, ./Test.out --headless skips them
+  if (argc > 1 && std::string(argv[1]) == "--headless") PlotQueue::instance().setHeadless(true);
+
   // Read data from file
   std::vector<double> data = read_file();
 
   // Find range of data, mean and standard deviation for more accurate graphical comparisons
-  std::array<int,2> min_max = data_range(data);
-  float min = min_max[0];
-  float max = min_max[1];
-  double mean = get_mean(data);
-  double standard_dev = stdev(data, mean);
+  Summary stats = summarise(data); // One pass for the moments
+  std::array<int,2> min_max = data_range(stats); // Models cover all of the data
+  double min = min_max[0];
+  double max = min_max[1];
+  std::array<double,2> plot_range = trimmed_range(sketch_data(data)); // Outer fences of the data, so outliers don't stretch the plots
+  double mean = stats.mean;
+  double standard_dev = stats.stdev();
+  std::cout << "Skewness: " << stats.skewness() << ", excess kurtosis: " << stats.kurtosis() << std::endl;
+
+  const int nModels = 4;
+  const unsigned long seed = 20231205; // Model k samples with seed + k, so runs are reproducible
+  int nThreads = std::max(1, thread_count() / nModels); // Threads for each model's own parallel loops
 
+  // Parameters below are starting values, an unbinned maximum likelihood fit to the data sets the final ones
   FiniteFunction function(min, max, "./Outputs/png/Inv-X-Squared.png");
-  processFunction(function, data);
+  NormalDistributionFunction normalFunc(min, max, "./Outputs/png/Normal-Dist.png", mean, standard_dev); // mu, sigma
+  CauchyLorentzDistribution cauchyFunc(min, max, "./Outputs/png/Cauchy-Lorentz.png", mean, 0.80); // x0, gamma
+  NegativeCrystalBallDistribution crystalFunc(min, max, "./Outputs/png/Negative-Crystal.png", mean, standard_dev, 2.0, 2.0); // xbar, sigma, alpha, n
+
+  function.setPlotRange(plot_range[0], plot_range[1]); // Only the plots and histograms are trimmed, fits and tests see all the data
+  normalFunc.setPlotRange(plot_range[0], plot_range[1]);
+  cauchyFunc.setPlotRange(plot_range[0], plot_range[1]);
+  crystalFunc.setPlotRange(plot_range[0], plot_range[1]);
+
+  Progress progress(nModels, "model");
+  ThreadPool pool;
+
+  pool.submit([&]() {
+    progress.start("Inv-X-Squared");
+    processFunction(function, data, seed, progress);
+    progress.finish("Inv-X-Squared");
+  });
 
-  // mu, sigma
-  NormalDistributionFunction normalFunc(min, max, "./Outputs/png/Normal-Dist.png", mean, standard_dev);
-  processFunction(normalFunc, data);
+  pool.submit([&]() {
+    progress.start("Normal");
+    std::vector<double> counts = normalFunc.binData(data, 50); // Binned fits only see the bin contents, so their cost doesn't grow with the data size
+    BinnedFitter normalBinnedFit(&normalFunc, counts);
+    report(normalBinnedFit.fitChiSquared(), "Normal binned chi2 fit", progress);
+    report(normalBinnedFit.fitPoisson(), "Normal binned Poisson fit", progress);
+    UnbinnedFitter normalFit(&normalFunc, data, nThreads);
+    FitResult normalResult = normalFit.fit();
+    report(normalResult, "Normal unbinned fit", progress);
+    // NLL surface over +-4 sigma of the fit in mu and sigma, for a contour plot of the likelihood. Without a usable
+    // error (Hessian not positive definite) the axis spans 10% of the value instead, like the fit's first simplex
+    auto axis = [&](int i) {
+      double e = normalResult.errors[i];
+      double width = (std::isfinite(e) && e > 0) ? 4*e : std::max(0.1*std::abs(normalResult.values[i]), 0.1);
+      return grid_axis(i, normalResult.values[i], width, 41);
+    };
+    GridScanResult normalGrid = scan_nll(&normalFunc, data, {axis(0), axis(1)}, nThreads);
+    {
+      std::lock_guard<std::mutex> lock(progress.console());
+      print_grid(normalGrid, "Normal NLL grid scan");
+    }
+    export_grid(normalGrid, "Outputs/data/Normal-Dist-NLL-Grid.csv");
+    processFunction(normalFunc, data, seed + 1, progress);
+    progress.finish("Normal");
+  });
 
-  // x0, gamma
-  CauchyLorentzDistribution cauchyFunc(min, max, "./Outputs/png/Cauchy-Lorentz.png", mean, 0.80);
-  processFunction(cauchyFunc, data);
+  pool.submit([&]() {
+    progress.start("Cauchy-Lorentz");
+    UnbinnedFitter cauchyFit(&cauchyFunc, data, nThreads);
+    report(cauchyFit.fit(), "Cauchy-Lorentz unbinned fit", progress);
+    processFunction(cauchyFunc, data, seed + 2, progress);
+    progress.finish("Cauchy-Lorentz");
+  });
 
-  // xbar, sigma, alpha, n
-  NegativeCrystalBallDistribution crystalFunc(min, max, "./Outputs/png/Negative-Crystal.png", mean, standard_dev, 2.0, 2.0);
-  processFunction(crystalFunc, data);
+  pool.submit([&]() {
+    progress.start("Negative-Crystal");
+    UnbinnedFitter crystalFit(&crystalFunc, data, nThreads);
+    report(crystalFit.fit(), "Negative Crystal Ball unbinned fit", progress);
+    processFunction(crystalFunc, data, seed + 3, progress);
+    progress.finish("Negative-Crystal");
+  });
 
+  pool.wait(); // End-to-end time is roughly that of the slowest model
   return 0;
-};
\ No newline at end of file
+};
@@ -0,0 +1,121 @@
+/**
+ * @file ThreadPool.cxx
+ * @author Kierran Falloon (kierran.falloon@strath.ac.uk)
+ * @date 05-12-2023
+ */
+
+#include <iostream>
+#include "ThreadPool.h"
+#include "Parallel.h"
+
+static thread_local ThreadPool* t_Pool = nullptr; //Pool the current thread works for
+static thread_local int t_Index = -1; //Its index in that pool
+
+ThreadPool::ThreadPool(int nThreads){
+  int n = thread_count(nThreads);
+  for (int i = 0; i < n; i++) m_Queues.push_back(std::make_unique<Queue>());
+  for (int i = 0; i < n; i++) m_Threads.emplace_back(&ThreadPool::work, this, i);
+}
+
+ThreadPool::~ThreadPool(){
+  this->wait();
+  {
+    std::lock_guard<std::mutex> lock(m_WakeMutex);
+    m_Stop = true;
+  }
+  m_Wake.notify_all();
+  for (std::thread &thread : m_Threads) thread.join();
+}
+
+int ThreadPool::workerIndex(){return t_Index;}
+
+void ThreadPool::submit(std::function<void()> task){
+  m_Pending++;
+  int target = (t_Pool == this) ? t_Index : m_Next++ % m_Queues.size();
+  {
+    std::lock_guard<std::mutex> lock(m_Queues[target]->mutex);
+    m_Queues[target]->tasks.push_back(std::move(task));
+  }
+  {
+    std::lock_guard<std::mutex> lock(m_WakeMutex);
+    m_Queued++;
+  }
+  m_Wake.notify_one();
+}
+
+void ThreadPool::wait(){
+  std::unique_lock<std::mutex> lock(m_WakeMutex);
+  m_Done.wait(lock, [this]() {return m_Pending == 0;});
+}
+
+bool ThreadPool::take(int self, std::function<void()> &task){
+  const int n = m_Queues.size();
+  for (int k = 0; k < n; k++){
+    int victim = (self + k) % n;
+    Queue &queue = *m_Queues[victim];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty()) continue;
+    if (k == 0){ //Own deque: newest first, it's likely still in cache
+      task = std::move(queue.tasks.back());
+      queue.tasks.pop_back();
+    }
+    else { //Steal the oldest, usually the biggest remaining piece of work
+      task = std::move(queue.tasks.front());
+      queue.tasks.pop_front();
+    }
+    return true;
+  }
+  return false;
+}
+
+void ThreadPool::work(int self){
+  t_Pool = this;
+  t_Index = self;
+  while (true){
+    {
+      std::unique_lock<std::mutex> lock(m_WakeMutex);
+      m_Wake.wait(lock, [this]() {return m_Stop || m_Queued > 0;});
+      if (m_Queued == 0) return; //Only reached once stopping
+    }
+    std::function<void()> task;
+    if (!this->take(self, task)) continue; //Another worker got there first
+    {
+      std::lock_guard<std::mutex> lock(m_WakeMutex);
+      m_Queued--;
+    }
+    task();
+    if (--m_Pending == 0){
+      std::lock_guard<std::mutex> lock(m_WakeMutex);
+      m_Done.notify_all();
+    }
+  }
+}
+
+/*
+###################
+//Progress
+###################
+*/
+
+Progress::Progress(int total, std::string label){
+  m_Total = total;
+  m_Label = label;
+  m_Start = std::chrono::steady_clock::now();
+}
+
+void Progress::start(std::string name){
+  std::lock_guard<std::mutex> lock(m_Console);
+  m_Started.emplace_back(name, std::chrono::steady_clock::now());
+  std::cout << "LOG: [" << m_Done << "/" << m_Total << "] " << m_Label << " started " << name << std::endl;
+}
+
+void Progress::finish(std::string name){
+  std::lock_guard<std::mutex> lock(m_Console);
+  auto now = std::chrono::steady_clock::now();
+  double taskTime = 0;
+  for (auto &started : m_Started){
+    if (started.first == name) taskTime = std::chrono::duration<double>(now - started.second).count();
+  }
+  m_Done++;
+  std::cout << "LOG: [" << m_Done << "/" << m_Total << "] " << m_Label << " finished " << name << " in " << taskTime << " s (" << std::chrono::duration<double>(now - m_Start).count() << " s elapsed)" << std::endl;
+}
@@ -0,0 +1,67 @@
+/**
+ * @file ThreadPool.h
+ * @author Kierran Falloon (kierran.falloon@strath.ac.uk)
+ * @date 05-12-2023
+ */
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#pragma once
+
+// Work-stealing thread pool. Every worker has its own deque: tasks submitted from inside a task go on the submitting
+// worker's deque and are taken newest first, while idle workers steal the oldest task from someone else's deque.
+// Uneven jobs (big and small files, cheap and expensive models) therefore balance across the cores by themselves.
+class ThreadPool{
+
+public:
+  ThreadPool(int nThreads = 0); //nThreads <= 0 uses every hardware thread
+  ~ThreadPool(); //Waits for outstanding tasks then stops the workers
+  void submit(std::function<void()> task); //Queue a task, safe to call from inside another task
+  void wait(); //Block until every submitted task (including ones they submit) has finished, don't call from a task
+  int size() {return m_Threads.size();};
+  static int workerIndex(); //Index of the calling worker in its pool, -1 if not called from a pool thread
+
+private:
+  struct Queue {
+    std::deque< std::function<void()> > tasks;
+    std::mutex mutex;
+  };
+  std::vector< std::unique_ptr<Queue> > m_Queues;
+  std::vector<std::thread> m_Threads;
+  std::atomic<long> m_Pending{0}; //Submitted but not finished
+  long m_Queued = 0; //Sitting in a deque, guarded by m_WakeMutex
+  bool m_Stop = false; //Guarded by m_WakeMutex
+  std::atomic<unsigned> m_Next{0}; //Round robin target for tasks submitted from outside the pool
+  std::mutex m_WakeMutex;
+  std::condition_variable m_Wake; //Work arrived or stopping
+  std::condition_variable m_Done; //m_Pending reached zero
+  bool take(int self, std::function<void()> &task); //Own deque first, then steal
+  void work(int self);
+};
+
+// "[done/total]" lines for a batch of pool tasks, plus a console lock so a task can print a whole block at once
+class Progress{
+
+public:
+  Progress(int total, std::string label);
+  void start(std::string name); //Task started
+  void finish(std::string name); //Task finished, prints its time and the elapsed time for the batch
+  std::mutex &console() {return m_Console;};
+
+private:
+  int m_Total;
+  int m_Done = 0; //Guarded by m_Console
+  std::string m_Label;
+  std::mutex m_Console;
+  std::chrono::steady_clock::time_point m_Start;
+  std::vector< std::pair<std::string, std::chrono::steady_clock::time_point> > m_Started; //Guarded by m_Console
+};
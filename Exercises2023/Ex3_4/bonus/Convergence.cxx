@@ -0,0 +1,88 @@
+/**
+ * @file Convergence.cxx
+ * @author Kierran Falloon (kierran.falloon@strath.ac.uk)
+ * @version 1.0
+ * @date 07-12-2023
+ * @headerfile Convergence.h
+ */
+
+#include <iostream>
+#include <cmath>
+
+#include "Convergence.h"
+
+/**
+ * @brief Opens the convergence table (if a filename is given) and writes its header.
+ *
+ * @param filename CSV file the checkpoints are streamed to, empty for none.
+ * @param perDecade Number of logarithmically spaced checkpoints per factor of 10 in the number of points.
+ * @param precision Standard error at which to stop, <= 0 to run all the points.
+ */
+ConvergenceLog::ConvergenceLog(std::string filename, int perDecade, double precision) {
+  m_PerDecade = std::max(1, perDecade);
+  m_Precision = precision;
+  m_Start = std::chrono::steady_clock::now();
+  if (filename.empty()) return;
+  m_File.open(filename);
+  if (!m_File.is_open()) {
+    std::cout << "LOG: Couldn't open " << filename << " for the convergence table" << std::endl;
+    exit(1);
+  }
+  m_File << "mode,nPoints,estimate,stdError,seconds" << std::endl;
+}
+
+/**
+ * @brief Resets the checkpoints and the clock, so several modes can share one table.
+ *
+ * @param mode Label for the rows of this run.
+ */
+void ConvergenceLog::begin(std::string mode) {
+  m_Mode = mode;
+  m_NextCheckpoint = 0;
+  m_LastRow = 0;
+  m_Start = std::chrono::steady_clock::now();
+}
+
+/**
+ * @brief Called by run_engine with the running totals at every chunk boundary, in order.
+ * Writes a row whenever a checkpoint has been passed, and stops the run once the standard error is below the
+ * requested precision. Only called once per chunk, so it costs nothing inside the point loop.
+ *
+ * @param nPoints Points counted so far.
+ * @param estimate The mode's estimate (of pi, or a ball volume) and its standard error from those points.
+ * @return True to stop the run.
+ */
+bool ConvergenceLog::record(std::uint64_t nPoints, Estimate estimate) {
+  bool passed = false;
+  while (std::pow(10.0, static_cast<double>(m_NextCheckpoint) / m_PerDecade) <= static_cast<double>(nPoints)) {
+    m_NextCheckpoint++;
+    passed = true;
+  }
+  if (passed) write(nPoints, estimate);
+
+  if (m_Precision > 0 && std::isfinite(estimate.error) && estimate.error > 0 && estimate.error <= m_Precision) {
+    if (!passed) write(nPoints, estimate);
+    std::cout << "LOG: Reached standard error " << m_Precision << " after " << nPoints << " points" << std::endl;
+    return true;
+  }
+  return false;
+}
+
+/**
+ * @brief Makes sure the table ends with the final totals.
+ */
+void ConvergenceLog::finish(std::uint64_t nPoints, Estimate estimate) {
+  if (nPoints != m_LastRow) write(nPoints, estimate);
+}
+
+void ConvergenceLog::write(std::uint64_t nPoints, Estimate estimate) { // private
+  m_LastRow = nPoints;
+  m_nRows++;
+  if (!m_File.is_open()) return;
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_Start).count();
+  m_File.precision(12);
+  m_File << m_Mode << "," << nPoints << "," << estimate.value << ",";
+  if (std::isnan(estimate.error)) m_File << "n/a";
+  else m_File << estimate.error;
+  m_File << "," << seconds << std::endl; // Flushed so long runs can be watched
+}
@@ -0,0 +1,35 @@
+/**
+ * @file Convergence.h
+ * @author Kierran Falloon (kierran.falloon@strath.ac.uk)
+ * @date 07-12-2023
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+#include "VarianceReduction.h"
+
+#pragma once
+
+class ConvergenceLog {
+
+public:
+  ConvergenceLog(std::string filename, int perDecade = 10, double precision = 0); // Empty filename = no table, precision <= 0 = never stop early
+  void begin(std::string mode); // Start the checkpoints and clock again for a new run, rows are labelled with mode
+  bool record(std::uint64_t nPoints, Estimate estimate); // run_engine observer, true once the precision is reached
+  void finish(std::uint64_t nPoints, Estimate estimate); // Write the final row if the last record() didn't
+  int nRows() {return m_nRows;};
+
+private:
+  void write(std::uint64_t nPoints, Estimate estimate);
+  std::ofstream m_File;
+  std::string m_Mode;
+  int m_PerDecade; // Checkpoints per factor of 10 in nPoints
+  double m_Precision; // Target standard error on the estimate
+  int m_NextCheckpoint = 0; // Next checkpoint is at 10^(m_NextCheckpoint/m_PerDecade) points
+  std::uint64_t m_LastRow = 0; // nPoints of the last row written
+  int m_nRows = 0;
+  std::chrono::steady_clock::time_point m_Start;
+};
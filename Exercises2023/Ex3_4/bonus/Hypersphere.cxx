@@ -0,0 +1,159 @@
+/**
+ * @file Hypersphere.cxx
+ * @author Kierran Falloon (kierran.falloon@strath.ac.uk)
+ * @version 1.0
+ * @date 07-12-2023
+ * @headerfile Hypersphere.h
+ */
+
+#include <iostream>
+#include <string>
+#include <cmath>
+
+#include "Hypersphere.h"
+#include "MonteCarloEngine.h"
+#include "SimdRandom.h"
+#include "Convergence.h"
+
+/*
+ * EstimatePi in any number of dimensions: the fraction of uniform points in the cube [-r, r)^D that land inside the
+ * D-ball, times the cube volume (2r)^D, estimates the ball volume. Points are handled simd_lanes at a time in
+ * structure of arrays form, one vector per coordinate holding that coordinate of every lane's point, so the squared
+ * norm is accumulated with one vector multiply-add per dimension.
+ */
+
+/**
+ * @brief Analytic volume of the n-ball, V_n(r) = π^(n/2) r^n / Γ(n/2 + 1).
+ */
+double ball_volume(int dim, double radius) {
+  return std::pow(M_PI, dim / 2.0) * std::pow(radius, dim) / std::tgamma(dim / 2.0 + 1);
+}
+
+/**
+ * @brief Volume estimate from nInBall of nPoints, with the binomial standard error scaled by the cube volume.
+ * With fewer than ball_min_hits points inside, a single hit (or none) would quote a tiny error, so the error is NaN
+ * and the precision stop waits for more hits.
+ */
+Estimate ball_estimate(int dim, double radius, std::uint64_t nPoints, std::uint64_t nInBall) {
+  double cube = std::pow(2 * radius, dim);
+  double p = static_cast<double>(nInBall) / static_cast<double>(nPoints);
+  if (nInBall < ball_min_hits) return {cube * p, NAN};
+  return {cube * p, cube * std::sqrt(p * (1 - p) / static_cast<double>(nPoints))};
+}
+
+/**
+ * @brief Compile-time dimension kernel. With D known the coordinate loop is fully unrolled and the whole step stays
+ * in registers, with no branches apart from the loop over steps.
+ *
+ * @tparam D The dimension.
+ * @param radius The radius of the ball.
+ * @param nPoints Number of points.
+ * @param seed Seed of this chunk's generators.
+ * @return Number of points inside the ball.
+ */
+template <int D>
+static std::uint64_t count_in_ball_static(double radius, std::uint64_t nPoints, std::uint64_t seed) {
+  SimdXoshiro gen(seed);
+  const double scale = 2 * radius; // [1, 2) -> [-r, r)
+  const double r2 = radius * radius;
+  i64v counts = {};
+  const std::uint64_t nSteps = (nPoints + simd_lanes - 1) / simd_lanes;
+  for (std::uint64_t i = 0; i < nSteps; i++) {
+    f64v norm = {};
+    for (int d = 0; d < D; d++) {
+      f64v x = (gen.uniform12() - 1.5) * scale;
+      norm += x * x;
+    }
+    i64v inside = (norm < r2);
+    if ((i + 1) * simd_lanes > nPoints) { // Mask off the lanes past the end
+      for (std::uint64_t l = nPoints - i * simd_lanes; l < (std::uint64_t)simd_lanes; l++) inside[l] = 0;
+    }
+    counts -= inside;
+  }
+  std::uint64_t nInBall = 0;
+  for (int l = 0; l < simd_lanes; l++) nInBall += counts[l];
+  return nInBall;
+}
+
+/**
+ * @brief Runtime dimension kernel. In high dimensions almost every point is outside the ball well before its last
+ * coordinate, so every 4 coordinates the step is abandoned once all lanes have a partial norm past r^2. At D = 20
+ * that skips most of the random numbers.
+ *
+ * @param dim The dimension.
+ * @param radius The radius of the ball.
+ * @param nPoints Number of points.
+ * @param seed Seed of this chunk's generators.
+ * @return Number of points inside the ball.
+ */
+std::uint64_t count_in_ball_dynamic(int dim, double radius, std::uint64_t nPoints, std::uint64_t seed) {
+  SimdXoshiro gen(seed);
+  const double scale = 2 * radius;
+  const double r2 = radius * radius;
+  i64v counts = {};
+  const std::uint64_t nSteps = (nPoints + simd_lanes - 1) / simd_lanes;
+  for (std::uint64_t i = 0; i < nSteps; i++) {
+    f64v norm = {};
+    bool allOutside = false;
+    for (int d = 0; d < dim; d++) {
+      f64v x = (gen.uniform12() - 1.5) * scale;
+      norm += x * x;
+      if ((d & 3) == 3) {
+        i64v outside = (norm >= r2);
+        allOutside = true;
+        for (int l = 0; l < simd_lanes; l++) allOutside &= (outside[l] != 0);
+        if (allOutside) break;
+      }
+    }
+    if (allOutside) continue;
+    i64v inside = (norm < r2);
+    if ((i + 1) * simd_lanes > nPoints) {
+      for (std::uint64_t l = nPoints - i * simd_lanes; l < (std::uint64_t)simd_lanes; l++) inside[l] = 0;
+    }
+    counts -= inside;
+  }
+  std::uint64_t nInBall = 0;
+  for (int l = 0; l < simd_lanes; l++) nInBall += counts[l];
+  return nInBall;
+}
+
+// Walk D = 1..ball_static_max to find the compile-time kernel for dim, or fall back to the runtime one
+template <int D = 1>
+static std::uint64_t dispatch_ball(int dim, double radius, std::uint64_t nPoints, std::uint64_t seed) {
+  if constexpr (D > ball_static_max) {
+    return count_in_ball_dynamic(dim, radius, nPoints, seed);
+  }
+  else {
+    if (dim == D) return count_in_ball_static<D>(radius, nPoints, seed);
+    return dispatch_ball<D + 1>(dim, radius, nPoints, seed);
+  }
+}
+
+/**
+ * @brief Counts uniform points of the cube [-r, r)^dim inside the dim-ball. This is the run_engine kernel.
+ */
+std::uint64_t count_in_ball(int dim, double radius, std::uint64_t nPoints, std::uint64_t seed) {
+  return dispatch_ball(dim, radius, nPoints, seed);
+}
+
+/**
+ * @brief Estimates the volume of the dim-ball on the threaded engine, with the same streaming, checkpoints and
+ * precision stop as the 2D modes. The 1-ball is the whole interval [-r, r), so it is exact and nothing is sampled.
+ *
+ * @param args Parsed arguments (radius, points, threads, seed).
+ * @param dim The dimension.
+ * @param log Convergence log, rows are labelled ball-<dim>.
+ * @return ModeResult with the volume estimate and timing.
+ */
+ModeResult run_ball(const Args &args, int dim, ConvergenceLog &log) {
+  const double radius = args.radius;
+  std::string mode = "ball-" + std::to_string(dim);
+  log.begin(mode);
+  if (dim == 1) return {mode, 0, {2 * radius, 0}, 0, 1}; // Every point would land inside, and an error of 0 never meets --precision
+  auto kernel = [dim, radius](std::uint64_t, std::uint64_t n, std::uint64_t seed) {return count_in_ball(dim, radius, n, seed);};
+  auto observer = [&](std::uint64_t n, std::uint64_t nInBall) {return log.record(n, ball_estimate(dim, radius, n, nInBall));};
+  auto result = run_engine(kernel, args.nRandomPoints, args.nThreads, args.seed, observer);
+  Estimate estimate = ball_estimate(dim, radius, result.nPoints, result.tally);
+  log.finish(result.nPoints, estimate);
+  return {mode, result.nPoints, estimate, result.seconds, result.nThreads};
+}
@@ -0,0 +1,23 @@
+/**
+ * @file Hypersphere.h
+ * @author Kierran Falloon (kierran.falloon@strath.ac.uk)
+ * @date 07-12-2023
+ */
+
+#include <cstdint>
+
+#include "PiHelperFunctions.h"
+#include "VarianceReduction.h"
+
+#pragma once
+
+const int ball_static_max = 8; // Dimensions up to this get a compile-time kernel, above it the runtime one
+const std::uint64_t ball_min_hits = 10; // Below this many points inside the binomial error is meaningless, so none is quoted
+
+class ConvergenceLog;
+
+double ball_volume(int dim, double radius); // Analytic n-ball volume, π^(n/2) r^n / Γ(n/2 + 1)
+Estimate ball_estimate(int dim, double radius, std::uint64_t nPoints, std::uint64_t nInBall); // Cube volume times the hit fraction, with its binomial error (NaN below ball_min_hits)
+std::uint64_t count_in_ball(int dim, double radius, std::uint64_t nPoints, std::uint64_t seed); // Count uniform points of the cube [-r, r)^dim inside the ball, picks the kernel for dim
+std::uint64_t count_in_ball_dynamic(int dim, double radius, std::uint64_t nPoints, std::uint64_t seed); // Runtime dimension kernel
+ModeResult run_ball(const Args &args, int dim, ConvergenceLog &log); // Estimate the dim-ball volume on the engine
@@ -0,0 +1,138 @@
+/**
+ * @file MonteCarloEngine.h
+ * @author Kierran Falloon (kierran.falloon@strath.ac.uk)
+ * @date 07-12-2023
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <cstdint>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#pragma once
+
+const std::uint64_t engine_chunk = 1ULL << 22; // Points per chunk, each chunk is one independent RNG stream
+const std::uint64_t engine_first_chunk = 1ULL << 10; // Size of the first chunk, sizes double from here to engine_chunk
+
+/**
+ * @brief Result of a streaming Monte Carlo run. Tally is whatever the kernel returns per chunk (a hit count for
+ * plain sampling, per cell or per replicate counts for the variance reduced modes).
+ */
+template <typename Tally = std::uint64_t>
+struct EngineResult {
+  std::uint64_t nPoints; // Points counted, less than asked for if an observer stopped the run
+  Tally tally; // Sum of the kernel results over all chunks
+  double seconds; // Wall time of the run
+  int nThreads; // Threads used
+};
+
+/**
+ * @brief Number of worker threads to use, nThreads <= 0 means one per hardware thread.
+ */
+inline int thread_count(int nThreads) {
+  if (nThreads > 0) return nThreads;
+  int hw = static_cast<int>(std::thread::hardware_concurrency());
+  return hw > 0 ? hw : 1;
+}
+
+/**
+ * @brief SplitMix64 of (seed, chunk), so neighbouring chunks get unrelated generator states.
+ */
+inline std::uint64_t stream_seed(std::uint64_t seed, std::uint64_t chunk) {
+  std::uint64_t z = seed + (chunk + 1) * 0x9E3779B97F4A7C15ULL;
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+/**
+ * @brief First point of chunk c. Chunks double in size from engine_first_chunk up to chunkSize and are then all
+ * chunkSize, so early chunk boundaries are spaced logarithmically and convergence can be followed from small N.
+ * chunkSize must be engine_first_chunk times a power of two.
+ */
+inline std::uint64_t chunk_start(std::uint64_t c, std::uint64_t chunkSize) {
+  if (c == 0) return 0;
+  std::uint64_t nRamp = 0; // Chunks 1..nRamp double in size
+  while ((engine_first_chunk << nRamp) < chunkSize) nRamp++;
+  if (c <= nRamp) return engine_first_chunk << (c - 1);
+  return chunkSize * (c - nRamp);
+}
+
+/**
+ * @brief Streams nPoints through kernel on nThreads threads without storing any of them.
+ *
+ * The points are cut into chunks (see chunk_start). Threads take the next chunk from a shared counter and call
+ * kernel(first, n, streamSeed), which generates and tests points first..first+n-1 and returns a tally of them
+ * (anything value initialisable with +=, normally integer counts). Every chunk seeds its own generator from
+ * (seed, chunk index) and the tallies are added in chunk order, so the result is the same for any number of
+ * threads. Memory use doesn't depend on nPoints.
+ *
+ * Finished chunks are added to a running total strictly in chunk order (threads that finish early park their count
+ * until the chunks before it are done), and observer(nPoints, tally) is called with the total at every chunk
+ * boundary. If it returns true the run stops there and the result covers exactly that prefix, again independent of
+ * the thread count. This costs one lock per chunk, nothing inside the kernel.
+ *
+ * @param kernel Callable Tally(std::uint64_t first, std::uint64_t n, std::uint64_t streamSeed).
+ * @param nPoints Total number of points.
+ * @param nThreads Number of threads, <= 0 for one per hardware thread.
+ * @param seed Base seed of the run.
+ * @param observer Callable bool(std::uint64_t nPoints, const Tally &tally), true to stop.
+ * @param chunkSize Points per chunk once the ramp is over.
+ * @return EngineResult with the total tally and timing.
+ */
+template <typename Kernel, typename Observer, typename Tally = std::invoke_result_t<Kernel, std::uint64_t, std::uint64_t, std::uint64_t>>
+EngineResult<Tally> run_engine(Kernel kernel, std::uint64_t nPoints, int nThreads, std::uint64_t seed, Observer observer, std::uint64_t chunkSize = engine_chunk) {
+  std::uint64_t nChunks = 0; // First chunk starting at or past nPoints
+  while (chunk_start(nChunks, chunkSize) < std::min(nPoints, chunkSize)) nChunks++; // Ramp
+  if (nPoints > chunkSize) nChunks += (nPoints - chunkSize + chunkSize - 1) / chunkSize;
+  nThreads = static_cast<int>(std::min<std::uint64_t>(thread_count(nThreads), std::max<std::uint64_t>(nChunks, 1)));
+
+  std::atomic<std::uint64_t> next{0};
+  std::atomic<bool> stop{false};
+  std::mutex mutex; // Guards everything below
+  std::map<std::uint64_t, Tally> parked; // Chunks finished ahead of the prefix, at most about nThreads
+  std::uint64_t done = 0; // Chunks [0, done) are in total
+  Tally total{};
+
+  auto worker = [&]() {
+    while (!stop.load(std::memory_order_relaxed)) {
+      std::uint64_t c = next.fetch_add(1, std::memory_order_relaxed);
+      if (c >= nChunks) break;
+      std::uint64_t first = chunk_start(c, chunkSize);
+      Tally tally = kernel(first, std::min(chunk_start(c + 1, chunkSize), nPoints) - first, stream_seed(seed, c));
+
+      std::lock_guard<std::mutex> lock(mutex);
+      if (stop) break;
+      parked.emplace(c, std::move(tally));
+      for (auto it = parked.find(done); it != parked.end(); it = parked.find(done)) {
+        total += it->second;
+        parked.erase(it);
+        done++;
+        if (observer(std::min(chunk_start(done, chunkSize), nPoints), total)) {
+          stop = true;
+          break;
+        }
+      }
+    }
+  };
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> workers;
+  for (int t = 1; t < nThreads; t++) workers.emplace_back(worker);
+  worker(); // Calling thread works too
+  for (std::thread &w : workers) w.join();
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  return {std::min(chunk_start(done, chunkSize), nPoints), total, seconds, nThreads};
+}
+
+// Run without an observer
+template <typename Kernel>
+auto run_engine(Kernel kernel, std::uint64_t nPoints, int nThreads, std::uint64_t seed) {
+  return run_engine(kernel, nPoints, nThreads, seed, [](std::uint64_t, const auto &) {return false;});
+}
@@ -7,77 +7,207 @@
  */
 
 #include <iostream>
-#include <vector>
+#include <string>
 #include <array>
-#include <stdio.h>
+#include <cmath>
 #include <random>
 
-/**
- * @brief Struct to hold the arguments for EstimatePi.
- * 
- * @param radius Radius of the circle.
- * @param nRandomPoints Number of random points to generate.
- * 
- */
-struct Args {
-  double radius;
-  int nRandomPoints;
-};
+#include "PiHelperFunctions.h"
+#include "MonteCarloEngine.h"
+#include "SimdRandom.h"
+
+static const std::string usage = "Call with ./EstimatePi [radius = 1.0] [nRandomPoints = 1000] [--threads N] [--seed S] [--kernel simd|scalar] [--mode plain|antithetic|stratified|sobol|all] [--benchmark] [--convergence file.csv] [--checkpoints perDecade] [--precision P] [--dim D|A:B]";
 
 /**
  * @brief Handles arguments.
- * 
- * @return Args struct containing the radius and number of random points.
+ *
+ * Positional radius and nRandomPoints as before, followed by optional --threads N, --seed S, --kernel simd|scalar,
+ * --mode plain|antithetic|stratified|sobol|all, --benchmark (no value, times both plain kernels),
+ * --convergence file.csv, --checkpoints perDecade, --precision P and --dim D (or a range A:B) for ball volumes.
+ * With --precision, nRandomPoints is only an upper limit (10^15 if it isn't given).
+ * Without --seed a random one is drawn and printed so the run can be repeated.
+ *
+ * @return Args struct containing the radius, number of random points, threads and seed.
  */
 Args handle_arguments(int argc, char *argv[]) {
   std::cout << std::endl;
   double radius = 1.0;
-  int nRandomPoints = 1000;
+  std::uint64_t nRandomPoints = 1000;
+  int nThreads = 0;
+  std::uint64_t seed = std::random_device{}();
+  std::string kernel = "simd";
+  std::string mode = "plain";
+  bool benchmark = false;
+  std::string convergence;
+  int perDecade = 10;
+  double precision = 0;
+  int dimMin = 2, dimMax = 2;
 
-  switch (argc) {
-  case 1: {
-    std::cout << "LOG: Assuming arguments are: radius = 1, nRandomPoints = 1000" << std::endl;
-    break; // No args passed, since argv[0] is the program name
+  int nPositional = 0;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--benchmark") {
+      benchmark = true;
+    }
+    else if (arg.rfind("--", 0) == 0) {
+      if (i + 1 >= argc) {
+        std::cout << "LOG: Missing value for " << arg << ". " << usage << std::endl;
+        exit(1);
+      }
+      if (arg == "--threads") nThreads = parse_int(argv[++i], "a number of threads", 0, 4096); // 0 = every hardware thread
+      else if (arg == "--seed") seed = parse_count(argv[++i], "a seed");
+      else if (arg == "--kernel") kernel = argv[++i];
+      else if (arg == "--mode") mode = argv[++i];
+      else if (arg == "--convergence") convergence = argv[++i];
+      else if (arg == "--checkpoints") perDecade = parse_int(argv[++i], "a number of checkpoints per decade", 1, 1000);
+      else if (arg == "--precision") precision = std::stod(argv[++i]);
+      else if (arg == "--dim") {
+        std::string dims = argv[++i];
+        std::size_t colon = dims.find(':');
+        dimMin = parse_int(dims.substr(0, colon), "a dimension", 1, 1000);
+        dimMax = (colon == std::string::npos) ? dimMin : parse_int(dims.substr(colon + 1), "a dimension", 1, 1000);
+      }
+      else {
+        std::cout << "LOG: Unknown option " << arg << ". " << usage << std::endl;
+        exit(1);
+      }
     }
-  case 2: {
-    std::cout << "LOG: Arg Radius = " << argv[1] << ". Setting nRandomPoints = 1000" << std::endl;
-    radius = std::stod(argv[1]);
-    break;
+    else if (nPositional == 0) {
+      radius = std::stod(arg);
+      nPositional++;
     }
-  case 3: {
-    std::cout << "LOG: Arg Radius = " << argv[1] << ", Arg nRandomPoints = " << argv[2] << std::endl;
-    radius = std::stod(argv[1]);
-    nRandomPoints = std::stoi(argv[2]);
-    break;
+    else if (nPositional == 1) {
+      nRandomPoints = parse_count(arg, "a number of points");
+      nPositional++;
     }
-  default: {
-    std::cout << "LOG: Too many arguments passed. Call with ./EstimatePi [radius = 1.0] [nRandomPoints = 1000]" << std::endl;
+    else {
+      std::cout << "LOG: Too many arguments passed. " << usage << std::endl;
+      exit(1);
+    }
+  }
+
+  if (kernel != "simd" && kernel != "scalar") {
+    std::cout << "LOG: Unknown kernel " << kernel << ". " << usage << std::endl;
     exit(1);
-    break;
+  }
+  if (mode != "plain" && mode != "antithetic" && mode != "stratified" && mode != "sobol" && mode != "all") {
+    std::cout << "LOG: Unknown mode " << mode << ". " << usage << std::endl;
+    exit(1);
+  }
+  if (dimMax < dimMin) {
+    std::cout << "LOG: Dimensions need A <= B in A:B. " << usage << std::endl;
+    exit(1);
+  }
+  if ((dimMin != 2 || dimMax != 2) && mode != "plain") {
+    std::cout << "LOG: Ball volumes only use plain sampling, the variance reduced modes are 2D" << std::endl;
+    exit(1);
+  }
+  if (precision > 0 && nPositional < 2) nRandomPoints = 1000000000000000ULL; // Run until precise enough
+  if (nRandomPoints == 0) {
+    std::cout << "LOG: nRandomPoints must be at least 1" << std::endl;
+    exit(1);
+  }
+  std::cout << "LOG: radius = " << radius << ", nRandomPoints = " << nRandomPoints << ", threads = " << thread_count(nThreads) << ", seed = " << seed << ", kernel = " << kernel << ", mode = " << mode << std::endl;
+  return {radius, nRandomPoints, nThreads, seed, kernel, mode, benchmark, convergence, perDecade, precision, dimMin, dimMax};
+}
+
+/**
+ * @brief Parses a number of points or a seed. Plain integers are read exactly, anything with an exponent (e.g. 1e12)
+ * through a double. Negatives, NaN, trailing junk and values of 2^64 or more exit with the usage message.
+ *
+ * @param value The argument string.
+ * @param what What the value is for, used in the error message.
+ * @return The parsed value.
+ */
+std::uint64_t parse_count(std::string value, std::string what) {
+  bool digits = !value.empty() && value.find_first_not_of("0123456789") == std::string::npos;
+  bool scientific = !digits && !value.empty() && value.find_first_not_of("0123456789.eE+") == std::string::npos; // No '-', so no negatives
+  try {
+    if (digits) return std::stoull(value);
+    if (scientific) {
+      std::size_t used = 0;
+      double count = std::stod(value, &used);
+      if (used == value.size() && count >= 0 && count < 18446744073709551616.0) return static_cast<std::uint64_t>(std::round(count));
     }
   }
+  catch (const std::exception &) {} // Past 2^64, or not a number after all
+  std::cout << "LOG: Can't use " << value << " as " << what << ". " << usage << std::endl;
+  exit(1);
+}
 
-  return {radius, nRandomPoints};
+/**
+ * @brief Parses a small integer option (threads, checkpoints, dimensions) through parse_count, so it is rejected the
+ * same way, and checks it lies in [min, max].
+ *
+ * @param value The argument string.
+ * @param what What the value is for, used in the error message.
+ * @param min Smallest allowed value.
+ * @param max Largest allowed value.
+ * @return The parsed value.
+ */
+int parse_int(std::string value, std::string what, int min, int max) {
+  std::uint64_t count = parse_count(value, what);
+  if (count < static_cast<std::uint64_t>(min) || count > static_cast<std::uint64_t>(max)) {
+    std::cout << "LOG: Can't use " << value << " as " << what << ", it must be between " << min << " and " << max << ". " << usage << std::endl;
+    exit(1);
+  }
+  return static_cast<int>(count);
 }
 
 /**
- * @brief Generates a vector of arrays containing nRandomPoints random coordinates within a square of sides 2*radius.
+ * @brief Generates nPoints random points within a square of sides 2*radius and counts those inside the circle.
+ * Points are tested as they are drawn, so nothing is stored. This is the kernel run_engine hands each chunk to.
  *
  * @param radius The radius of the circle.
- * @param nRandomPoints The number of random points to generate.
- * @return A vector of arrays, where each array contains the x and y coordinates of a random point.
+ * @param nPoints The number of random points to generate.
+ * @param seed Seed of this chunk's generator.
+ * @return The number of points inside the circle.
  */
-std::vector<std::array<double, 2>> generate_random(double radius, int nRandomPoints) {
-  std::vector<std::array<double, 2>> random;
-  std::random_device rd;
-  std::mt19937 gen(rd());
+std::uint64_t count_in_circle(double radius, std::uint64_t nPoints, std::uint64_t seed) {
+  std::mt19937_64 gen(seed);
   std::uniform_real_distribution<> dis(-radius, radius);
+  std::uint64_t nInCircle = 0;
+  for (std::uint64_t i = 0; i < nPoints; i++) {
+    double x = dis(gen);
+    double y = dis(gen);
+    nInCircle += is_in_circle({x, y}, radius);
+  }
+  return nInCircle;
+}
+
+/**
+ * @brief Vectorised count_in_circle: every step draws simd_lanes x and y coordinates at once, tests
+ * x^2 + y^2 < r^2 across the lanes and subtracts the comparison masks (-1 for true) from a vector of counters,
+ * so there are no branches and nothing leaves the registers until the end of the chunk.
+ *
+ * @param radius The radius of the circle.
+ * @param nPoints The number of random points to generate.
+ * @param seed Seed of this chunk's generators.
+ * @return The number of points inside the circle.
+ */
+std::uint64_t count_in_circle_simd(double radius, std::uint64_t nPoints, std::uint64_t seed) {
+  SimdXoshiro gen(seed);
+  const double scale = 2 * radius; // [1, 2) -> [-r, r)
+  const double r2 = radius * radius;
+  i64v counts = {};
+  for (std::uint64_t i = 0; i < nPoints / simd_lanes; i++) {
+    f64v x = (gen.uniform12() - 1.5) * scale;
+    f64v y = (gen.uniform12() - 1.5) * scale;
+    counts -= (x * x + y * y < r2);
+  }
 
-  for (int i = 0; i < nRandomPoints; i++) {
-    random.push_back({dis(gen), dis(gen)});
+  // Last partial step, lanes past the end are masked off
+  std::uint64_t remainder = nPoints % simd_lanes;
+  if (remainder > 0) {
+    f64v x = (gen.uniform12() - 1.5) * scale;
+    f64v y = (gen.uniform12() - 1.5) * scale;
+    i64v inside = (x * x + y * y < r2);
+    for (std::uint64_t l = 0; l < remainder; l++) counts[l] -= inside[l];
   }
 
-  return random;
+  std::uint64_t nInCircle = 0;
+  for (int l = 0; l < simd_lanes; l++) nInCircle += counts[l];
+  return nInCircle;
 }
 
 /**
@@ -93,6 +223,21 @@ bool is_in_circle(std::array<double, 2> point, double radius) {
   return (point[0] * point[0] + point[1] * point[1]) < radius * radius;
 }
 
+/**
+ * @brief Estimate of pi from the fraction of points inside the circle, π = 4 * A_circle / A_square.
+ */
+double pi_estimate(std::uint64_t nPoints, std::uint64_t nInCircle) {
+  return 4.0 * static_cast<double>(nInCircle) / static_cast<double>(nPoints);
+}
+
+/**
+ * @brief Standard error on pi_estimate. nInCircle is binomial with p = π/4, so σ_π = 4 * sqrt(p(1-p)/N).
+ */
+double pi_std_error(std::uint64_t nPoints, std::uint64_t nInCircle) {
+  double p = static_cast<double>(nInCircle) / static_cast<double>(nPoints);
+  return 4.0 * std::sqrt(p * (1 - p) / static_cast<double>(nPoints));
+}
+
 /**
  * @brief Calculates the percentage error between the given value of pi and the actual value of pi.
  * 
@@ -100,7 +245,7 @@ bool is_in_circle(std::array<double, 2> point, double radius) {
  * @return The percentage error between the given value of pi and the actual value of pi.
  */
 double error(double pi) {
-  float m_pi = 3.14159265358979323846;
+  double m_pi = 3.14159265358979323846; // double, a float pi is only good to 1e-7
 
   std::cout << std::endl;
   std::cout << std::fixed;
@@ -5,16 +5,31 @@
  */
 
 #include <array>
-#include <vector>
+#include <cstdint>
+#include <string>
 
 #pragma once
 
 struct Args {
     double radius;
-    int nRandomPoints;
+    std::uint64_t nRandomPoints; // 64 bit so runs can go past 2^31 points
+    int nThreads; // 0 = one per hardware thread
+    std::uint64_t seed;
+    std::string kernel; // "simd" (default) or "scalar", for plain sampling
+    std::string mode; // plain, antithetic, stratified, sobol or all
+    bool benchmark; // Time both kernels with the same seed and point count (different generators, so not the same points)
+    std::string convergence; // CSV file for the convergence table, empty for none
+    int perDecade; // Checkpoints per decade of nRandomPoints
+    double precision; // Stop once the standard error on the estimate is this small, 0 = never
+    int dimMin, dimMax; // Ball dimensions to estimate the volume of, 2 (and 2) estimates pi as usual
 };
 
 Args handle_arguments(int argc, char *argv[]); // Unpack arguments into Args struct
-std::vector<std::array<double, 2>> generate_random(double radius, int nRandomPoints); // Generate nRandomPoints random points within a square of side length 2*radius
+std::uint64_t parse_count(std::string value, std::string what); // Parse a non-negative count or seed, accepting 1e12 style as well as integers; exits with the usage otherwise
+int parse_int(std::string value, std::string what, int min, int max); // parse_count limited to [min, max], for threads, checkpoints and dimensions
+std::uint64_t count_in_circle(double radius, std::uint64_t nPoints, std::uint64_t seed); // Generate nPoints points in the square of side 2*radius one at a time and count those in the circle
+std::uint64_t count_in_circle_simd(double radius, std::uint64_t nPoints, std::uint64_t seed); // Same count with simd_lanes points per step from SimdXoshiro, counted in vector registers
 bool is_in_circle(std::array<double, 2> point, double radius); // Check if a point is within a circle of radius radius
-double error(double pi); // Calculate the percentage error of the estimate of pi
\ No newline at end of file
+double pi_estimate(std::uint64_t nPoints, std::uint64_t nInCircle); // 4 * nInCircle / nPoints
+double pi_std_error(std::uint64_t nPoints, std::uint64_t nInCircle); // Binomial standard error on pi_estimate
+double error(double pi); // Calculate the percentage error of the estimate of pi
@@ -0,0 +1,61 @@
+/**
+ * @file SimdRandom.h
+ * @author Kierran Falloon (kierran.falloon@strath.ac.uk)
+ * @date 07-12-2023
+ */
+
+#include <cstdint>
+
+#include "MonteCarloEngine.h"
+
+#pragma once
+
+/*
+ * GCC/Clang vector extensions: arithmetic on these types is done lane by lane in SIMD registers
+ * (one AVX-512 register, two AVX2 or four SSE registers, whatever -march allows).
+ */
+const int simd_lanes = 8;
+typedef std::uint64_t u64v __attribute__((vector_size(8 * simd_lanes)));
+typedef std::int64_t i64v __attribute__((vector_size(8 * simd_lanes)));
+typedef double f64v __attribute__((vector_size(8 * simd_lanes)));
+typedef std::uint32_t u32v __attribute__((vector_size(4 * simd_lanes))); // Same lane count at half the width
+
+/**
+ * @brief simd_lanes interleaved xoshiro256+ generators, one per lane, stepped together.
+ *
+ * xoshiro256+ only needs adds, xors and shifts, so a step of all lanes is a handful of vector instructions. Each lane
+ * is seeded from a SplitMix64 sequence of the seed, which is how the xoshiro authors recommend filling the state.
+ */
+class SimdXoshiro {
+
+public:
+  SimdXoshiro(std::uint64_t seed) {
+    for (int l = 0; l < simd_lanes; l++) {
+      m_S0[l] = stream_seed(seed, 4 * l);
+      m_S1[l] = stream_seed(seed, 4 * l + 1);
+      m_S2[l] = stream_seed(seed, 4 * l + 2);
+      m_S3[l] = stream_seed(seed, 4 * l + 3);
+    }
+  };
+
+  // Next 64 random bits in every lane
+  inline u64v next() {
+    u64v result = m_S0 + m_S3;
+    u64v t = m_S1 << 17;
+    m_S2 ^= m_S0;
+    m_S3 ^= m_S1;
+    m_S1 ^= m_S2;
+    m_S0 ^= m_S3;
+    m_S2 ^= t;
+    m_S3 = (m_S3 << 45) | (m_S3 >> 19);
+    return result;
+  };
+
+  // Uniform doubles in [1, 2): the top 52 bits become the mantissa under a fixed exponent, no int to double conversion
+  inline f64v uniform12() {
+    return (f64v)((next() >> 12) | 0x3FF0000000000000ULL);
+  };
+
+private:
+  u64v m_S0, m_S1, m_S2, m_S3;
+};
@@ -0,0 +1,296 @@
+/**
+ * @file VarianceReduction.cxx
+ * @author Kierran Falloon (kierran.falloon@strath.ac.uk)
+ * @version 1.0
+ * @date 07-12-2023
+ * @headerfile VarianceReduction.h
+ */
+
+#include <iostream>
+#include <array>
+#include <cmath>
+
+#include "VarianceReduction.h"
+#include "MonteCarloEngine.h"
+#include "SimdRandom.h"
+#include "Convergence.h"
+
+/*
+ * Every mode estimates the quarter circle fraction p = π/4 and runs through run_engine, so they all stream, thread
+ * and checkpoint the same way. Only the kernel (how a chunk of points is drawn) and the tally (what has to be kept to
+ * get an error back out) differ.
+ */
+
+/**
+ * @brief Standard error after one second of compute on one thread. For 1/sqrt(N) methods this doesn't depend on
+ * how long the run was, so it compares modes directly: the one with the smallest value is cheapest for any accuracy.
+ */
+double ModeResult::errorPerSecond() const {
+  return estimate.error * std::sqrt(seconds * nThreads);
+}
+
+/**
+ * @brief Rounds nPoints up to what a mode can use. The variance reduced modes work on whole rounds of strata points
+ * (every chunk is a multiple of that), and Sobol replicates only have 2^32 points each.
+ */
+std::uint64_t mode_points(std::string mode, std::uint64_t nPoints) {
+  if (mode == "plain") return nPoints;
+  std::uint64_t rounded = (nPoints + strata - 1) / strata * strata;
+  const std::uint64_t sobolMax = sobol_replicates * (1ULL << 32);
+  if (mode == "sobol" && rounded > sobolMax) {
+    std::cout << "LOG: Sobol replicates have 2^32 points each, running " << sobolMax << " points" << std::endl;
+    return sobolMax;
+  }
+  return rounded;
+}
+
+/*
+###################
+//Kernels
+###################
+*/
+
+/**
+ * @brief Antithetic pairs: each random point p in the quarter square is paired with (r, r) - p. A point near the
+ * centre of the circle has its partner near the corner, so the two indicators are negatively correlated and the pair
+ * average varies less than two independent points.
+ *
+ * @param radius The radius of the circle.
+ * @param nPoints Number of points, nPoints/2 pairs.
+ * @param seed Seed of this chunk's generators.
+ * @return Number of pairs with both and with exactly one point inside.
+ */
+PairTally count_antithetic(double radius, std::uint64_t nPoints, std::uint64_t seed) {
+  SimdXoshiro gen(seed);
+  const double r2 = radius * radius;
+  const std::uint64_t nPairs = nPoints / 2;
+  i64v both = {}, one = {};
+  for (std::uint64_t i = 0; i < (nPairs + simd_lanes - 1) / simd_lanes; i++) {
+    f64v u = gen.uniform12() - 1.0;
+    f64v v = gen.uniform12() - 1.0;
+    f64v x = u * radius, y = v * radius;
+    f64v xa = (1.0 - u) * radius, ya = (1.0 - v) * radius;
+    i64v in = (x * x + y * y < r2);
+    i64v inAnti = (xa * xa + ya * ya < r2);
+    if ((i + 1) * simd_lanes > nPairs) { // Mask off the lanes past the last pair
+      for (std::uint64_t l = nPairs - i * simd_lanes; l < (std::uint64_t)simd_lanes; l++) in[l] = inAnti[l] = 0;
+    }
+    both -= in & inAnti;
+    one -= in ^ inAnti;
+  }
+  PairTally tally;
+  for (int l = 0; l < simd_lanes; l++) {
+    tally.both += both[l];
+    tally.one += one[l];
+  }
+  return tally;
+}
+
+/**
+ * @brief Stratified sampling: the quarter square is cut into strata_per_side^2 cells and every round of strata points
+ * puts one uniformly jittered point in each cell. Cells entirely inside or outside the circle then contribute no
+ * variance at all, only the cells the arc passes through do. nPoints must be a multiple of strata.
+ *
+ * @param radius The radius of the circle.
+ * @param nPoints Number of points.
+ * @param seed Seed of this chunk's generators.
+ * @return Hits per cell.
+ */
+CountTally count_stratified(double radius, std::uint64_t nPoints, std::uint64_t seed) {
+  SimdXoshiro gen(seed);
+  const double cell = radius / strata_per_side;
+  const double r2 = radius * radius;
+  f64v lane;
+  for (int l = 0; l < simd_lanes; l++) lane[l] = l;
+  std::vector<i64v> counts(strata / simd_lanes, i64v{}); // simd_lanes neighbouring cells of a row per vector
+  for (std::uint64_t round = 0; round < nPoints / strata; round++) {
+    for (int b = 0; b < strata / simd_lanes; b++) {
+      int cx = (b * simd_lanes) % strata_per_side;
+      int cy = (b * simd_lanes) / strata_per_side;
+      f64v x = (lane + (cx - 1.0) + gen.uniform12()) * cell; // uniform12 is in [1, 2)
+      f64v y = ((cy - 1.0) + gen.uniform12()) * cell;
+      counts[b] -= (x * x + y * y < r2);
+    }
+  }
+  CountTally tally;
+  tally.hits.resize(strata);
+  for (int c = 0; c < strata; c++) tally.hits[c] = counts[c / simd_lanes][c % simd_lanes];
+  return tally;
+}
+
+// Reverse the bits of every lane
+static u32v reverse_bits(u32v x) {
+  x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+  x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+  x = ((x >> 4) & 0x0F0F0F0Fu) | ((x & 0x0F0F0F0Fu) << 4);
+  x = ((x >> 8) & 0x00FF00FFu) | ((x & 0x00FF00FFu) << 8);
+  return (x >> 16) | (x << 16);
+}
+
+// Nested uniform (Owen) scramble by hashing (Burley 2020), each bit is flipped depending only on the bits above it.
+// Takes x already bit reversed, the Sobol points are kept that way so only the final reverse is paid per point.
+static u32v owen_scramble_reversed(u32v x, u32v seed) {
+  x += seed;
+  x ^= x * 0x6c50b47cu;
+  x ^= x * 0xb82f1e52u;
+  x ^= x * 0xc7afe638u;
+  x ^= x * 0x8d22f6e6u;
+  return reverse_bits(x);
+}
+
+/**
+ * @brief Randomised quasi-Monte Carlo: sobol_replicates independently Owen scrambled copies of the 2D Sobol sequence,
+ * one per SIMD lane. Point i of the run is point i/R of replicate i%R, so a chunk [first, first+n) takes the same
+ * n/R consecutive Sobol points from every replicate and only the scramble differs between lanes. The scrambles come
+ * from the run seed rather than the chunk seed since each replicate has to be one sequence across all chunks.
+ *
+ * @param radius The radius of the circle.
+ * @param first First point of the chunk, a multiple of sobol_replicates.
+ * @param nPoints Number of points, a multiple of sobol_replicates.
+ * @param seed Seed of the run.
+ * @return Hits per replicate.
+ */
+CountTally count_sobol(double radius, std::uint64_t first, std::uint64_t nPoints, std::uint64_t seed) {
+  // Bit reversed direction numbers: van der Corput, then the (s = 1, a = 0, m = 1) Joe-Kuo dimension
+  static const auto directions = []() {
+    std::array<std::array<std::uint32_t, 32>, 2> v;
+    for (int k = 0; k < 32; k++) {
+      v[0][k] = 1u << (31 - k);
+      v[1][k] = (k == 0) ? 1u << 31 : v[1][k - 1] ^ (v[1][k - 1] >> 1);
+    }
+    for (int k = 0; k < 32; k++) {
+      u32v reversed = reverse_bits(u32v{} + v[0][k]);
+      v[0][k] = reversed[0];
+      reversed = reverse_bits(u32v{} + v[1][k]);
+      v[1][k] = reversed[0];
+    }
+    return v;
+  }();
+  static_assert(sobol_replicates == simd_lanes, "One Sobol replicate per lane");
+
+  u32v scrambleX, scrambleY;
+  for (int l = 0; l < simd_lanes; l++) {
+    scrambleX[l] = static_cast<std::uint32_t>(stream_seed(seed, 2 * l));
+    scrambleY[l] = static_cast<std::uint32_t>(stream_seed(seed, 2 * l + 1));
+  }
+
+  std::uint32_t index = first / sobol_replicates;
+  std::uint32_t x = 0, y = 0;
+  for (std::uint32_t bits = index, k = 0; bits; bits >>= 1, k++) {
+    if (bits & 1) {
+      x ^= directions[0][k];
+      y ^= directions[1][k];
+    }
+  }
+
+  const double scale = radius / 4294967296.0; // 2^-32 * r
+  const double r2 = radius * radius;
+  i64v counts = {};
+  for (std::uint64_t i = 0; i < nPoints / sobol_replicates; i++, index++) {
+    u32v sx = owen_scramble_reversed(u32v{} + x, scrambleX);
+    u32v sy = owen_scramble_reversed(u32v{} + y, scrambleY);
+    f64v px = (__builtin_convertvector(sx, f64v) + 0.5) * scale;
+    f64v py = (__builtin_convertvector(sy, f64v) + 0.5) * scale;
+    counts -= (px * px + py * py < r2);
+    // index -> index+1 flips the trailing ones and the zero above them
+    for (std::uint32_t flipped = index ^ (index + 1), k = 0; flipped; flipped >>= 1, k++) {
+      x ^= directions[0][k];
+      y ^= directions[1][k];
+    }
+  }
+  CountTally tally;
+  for (int l = 0; l < simd_lanes; l++) tally.hits.push_back(counts[l]);
+  return tally;
+}
+
+/*
+###################
+//Estimates
+###################
+*/
+
+Estimate plain_estimate(std::uint64_t nPoints, std::uint64_t nInCircle) {
+  return {pi_estimate(nPoints, nInCircle), pi_std_error(nPoints, nInCircle)};
+}
+
+/**
+ * @brief Mean and error of the pair averages h = (I + I_anti)/2, which are 1, 1/2 or 0.
+ */
+Estimate antithetic_estimate(std::uint64_t nPoints, const PairTally &tally) {
+  double nPairs = static_cast<double>(nPoints / 2);
+  double mean = (2.0 * tally.both + tally.one) / (2 * nPairs);
+  double meanSquare = (tally.both + 0.25 * tally.one) / nPairs;
+  double var = std::max(0.0, meanSquare - mean * mean) * nPairs / std::max(1.0, nPairs - 1);
+  return {4 * mean, 4 * std::sqrt(var / nPairs)};
+}
+
+/**
+ * @brief Equal weight average of the cell fractions, with the variance summed over cells, Σ p_c(1-p_c)/(m-1) / K^4.
+ * With one point per cell every p_c is 0 or 1 and there is no spread to measure, so the error is NaN until m >= 2.
+ */
+Estimate stratified_estimate(std::uint64_t nPoints, const CountTally &tally) {
+  double perCell = static_cast<double>(nPoints / strata);
+  double mean = 0, var = 0;
+  for (std::uint64_t hits : tally.hits) {
+    double p = hits / perCell;
+    mean += p / strata;
+    var += p * (1 - p) / (perCell - 1) / ((double)strata * strata);
+  }
+  if (perCell < 2) var = NAN;
+  return {4 * mean, 4 * std::sqrt(var)};
+}
+
+/**
+ * @brief Mean of the replicate estimates, with the error from their spread.
+ */
+Estimate sobol_estimate(std::uint64_t nPoints, const CountTally &tally) {
+  double perReplicate = static_cast<double>(nPoints / sobol_replicates);
+  double mean = 0, var = 0;
+  for (std::uint64_t hits : tally.hits) mean += hits / perReplicate / sobol_replicates;
+  for (std::uint64_t hits : tally.hits) var += (hits / perReplicate - mean) * (hits / perReplicate - mean) / (sobol_replicates - 1);
+  return {4 * mean, 4 * std::sqrt(var / sobol_replicates)};
+}
+
+/*
+###################
+//Running
+###################
+*/
+
+/**
+ * @brief Runs one sampling mode (plain, antithetic, stratified or sobol) through run_engine, feeding the convergence
+ * log with the mode's estimate at every chunk boundary.
+ *
+ * @param args Parsed arguments (radius, points, threads, seed, kernel for plain mode).
+ * @param mode The sampling mode.
+ * @param log Convergence log, also decides when to stop early.
+ * @return ModeResult with the estimate and timing.
+ */
+ModeResult run_mode(const Args &args, std::string mode, ConvergenceLog &log) {
+  const std::uint64_t nPoints = mode_points(mode, args.nRandomPoints);
+  const double radius = args.radius;
+  const std::uint64_t runSeed = args.seed;
+  log.begin(mode);
+
+  auto run = [&](auto kernel, auto estimate) {
+    auto observer = [&](std::uint64_t n, const auto &tally) {return log.record(n, estimate(n, tally));};
+    auto result = run_engine(kernel, nPoints, args.nThreads, args.seed, observer);
+    Estimate final = estimate(result.nPoints, result.tally);
+    log.finish(result.nPoints, final);
+    return ModeResult{mode, result.nPoints, final, result.seconds, result.nThreads};
+  };
+
+  if (mode == "antithetic") {
+    return run([radius](std::uint64_t, std::uint64_t n, std::uint64_t seed) {return count_antithetic(radius, n, seed);}, antithetic_estimate);
+  }
+  if (mode == "stratified") {
+    return run([radius](std::uint64_t, std::uint64_t n, std::uint64_t seed) {return count_stratified(radius, n, seed);}, stratified_estimate);
+  }
+  if (mode == "sobol") {
+    return run([radius, runSeed](std::uint64_t first, std::uint64_t n, std::uint64_t) {return count_sobol(radius, first, n, runSeed);}, sobol_estimate);
+  }
+  if (args.kernel == "scalar") {
+    return run([radius](std::uint64_t, std::uint64_t n, std::uint64_t seed) {return count_in_circle(radius, n, seed);}, plain_estimate);
+  }
+  return run([radius](std::uint64_t, std::uint64_t n, std::uint64_t seed) {return count_in_circle_simd(radius, n, seed);}, plain_estimate);
+}
@@ -0,0 +1,61 @@
+/**
+ * @file VarianceReduction.h
+ * @author Kierran Falloon (kierran.falloon@strath.ac.uk)
+ * @date 07-12-2023
+ */
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "PiHelperFunctions.h"
+
+#pragma once
+
+const int strata_per_side = 32; // Stratified mode uses a 32x32 grid of cells over the quarter square
+const int strata = strata_per_side * strata_per_side; // = engine_first_chunk, so every chunk fills every cell equally
+const int sobol_replicates = 8; // Independently scrambled Sobol sequences, one per SIMD lane
+
+struct Estimate {
+  double value; // Estimate of pi (or of a ball volume)
+  double error; // Standard error on value, NaN when there are too few points to measure it
+};
+
+// Antithetic mode: how many (p, 1-p) pairs had both or exactly one point inside
+struct PairTally {
+  std::uint64_t both = 0, one = 0;
+  PairTally &operator+=(const PairTally &other) {both += other.both; one += other.one; return *this;};
+};
+
+// Stratified and Sobol modes: hits per cell or per replicate
+struct CountTally {
+  std::vector<std::uint64_t> hits;
+  CountTally &operator+=(const CountTally &other) {
+    if (hits.size() < other.hits.size()) hits.resize(other.hits.size(), 0);
+    for (std::size_t i = 0; i < other.hits.size(); i++) hits[i] += other.hits[i];
+    return *this;
+  };
+};
+
+struct ModeResult {
+  std::string mode;
+  std::uint64_t nPoints;
+  Estimate estimate;
+  double seconds; // Wall time
+  int nThreads;
+  double errorPerSecond() const; // Standard error after one second of compute (one thread), error * sqrt(seconds * nThreads)
+};
+
+class ConvergenceLog;
+
+std::uint64_t mode_points(std::string mode, std::uint64_t nPoints); // nPoints rounded up to what the mode can use
+ModeResult run_mode(const Args &args, std::string mode, ConvergenceLog &log); // Run one sampling mode on the engine
+
+PairTally count_antithetic(double radius, std::uint64_t nPoints, std::uint64_t seed); // nPoints/2 antithetic pairs in the quarter square
+CountTally count_stratified(double radius, std::uint64_t nPoints, std::uint64_t seed); // nPoints/strata jittered points in each cell
+CountTally count_sobol(double radius, std::uint64_t first, std::uint64_t nPoints, std::uint64_t seed); // Points first/R.. of every scrambled replicate
+
+Estimate plain_estimate(std::uint64_t nPoints, std::uint64_t nInCircle);
+Estimate antithetic_estimate(std::uint64_t nPoints, const PairTally &tally);
+Estimate stratified_estimate(std::uint64_t nPoints, const CountTally &tally);
+Estimate sobol_estimate(std::uint64_t nPoints, const CountTally &tally);
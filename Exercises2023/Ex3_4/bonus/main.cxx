@@ -6,11 +6,30 @@
 */
 
 #include <iostream>
-#include <vector>
-#include <array>
 #include <cmath>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <vector>
 
 #include "PiHelperFunctions.h"
+#include "MonteCarloEngine.h"
+#include "SimdRandom.h"
+#include "Convergence.h"
+#include "VarianceReduction.h"
+#include "Hypersphere.h"
+
+/**
+ * @brief Formats a standard error (or anything derived from one) like std::cout would, or "n/a" when it is NaN
+ * because the mode had too few points to measure its spread.
+ */
+std::string error_text(double value) {
+  if (std::isnan(value)) return "n/a";
+  std::ostringstream text;
+  text.copyfmt(std::cout);
+  text << value;
+  return text.str();
+}
 
 /**
  * @brief Main function. Called via ./EstimatePi
@@ -19,6 +38,9 @@
  * π = 4 * A_circle / A_square
  * 
  * Where A_circle and A_square can be approximated by counting the number of points in each shape, for a high enough number of points.
+ * Points are streamed through run_engine, so memory use is constant and 10^12 point runs are fine.
+ * --mode picks plain sampling or one of the variance reduced modes (see VarianceReduction.cxx), --mode all compares them.
+ * --dim estimates the volume of a ball in other dimensions instead (see Hypersphere.cxx).
  * 
  * @param argc Number of arguments passed to the program.
  * @param argv Array of arguments passed to the program.
@@ -30,28 +52,75 @@ int main(int argc, char *argv[]) {
   // Get args
   Args args = handle_arguments(argc, argv);
 
-  // Generate random points
-  std::vector<std::array<double, 2>> random = generate_random(args.radius, args.nRandomPoints);
+  // Time the two plain kernels against each other with the same seed and point count. The points themselves differ:
+  // the scalar kernel draws from mt19937_64 and the SIMD kernel from xoshiro256+
+  if (args.benchmark) {
+    auto scalar = [&args](std::uint64_t, std::uint64_t n, std::uint64_t seed) {return count_in_circle(args.radius, n, seed);};
+    auto simd = [&args](std::uint64_t, std::uint64_t n, std::uint64_t seed) {return count_in_circle_simd(args.radius, n, seed);};
+    auto scalarResult = run_engine(scalar, args.nRandomPoints, args.nThreads, args.seed);
+    auto simdResult = run_engine(simd, args.nRandomPoints, args.nThreads, args.seed);
+    double scalarRate = args.nRandomPoints / scalarResult.seconds / 1e9;
+    double simdRate = args.nRandomPoints / simdResult.seconds / 1e9;
+    std::cout << "LOG: scalar kernel " << scalarRate << " points/ns, simd kernel (" << simd_lanes << " lanes) " << simdRate << " points/ns, speed up x" << simdRate / scalarRate << std::endl;
+    return 0;
+  }
+
+  // Generate and count points chunk by chunk on every thread, nothing is stored
+  ConvergenceLog log(args.convergence, args.perDecade, args.precision);
 
-  // Count points in circle
-  int nInCircle = 0;
-  for (auto point : random) {
-    if (is_in_circle(point, args.radius)) {
-      nInCircle++;
+  // Ball volumes in other dimensions, checked against the analytic volume
+  if (args.dimMin != 2 || args.dimMax != 2) {
+    std::vector<int> sparse; // Dimensions with fewer than ball_min_hits points inside, so no error or deviation is quoted
+    std::cout << std::endl << "LOG: dimension, points, hits, estimate, standard error, analytic, deviation (sigma), points/ns" << std::endl;
+    for (int dim = args.dimMin; dim <= args.dimMax; dim++) {
+      ModeResult result = run_ball(args, dim, log);
+      double analytic = ball_volume(dim, args.radius);
+      std::uint64_t hits = std::llround(result.estimate.value / std::pow(2 * args.radius, dim) * result.nPoints);
+      std::ostringstream pull;
+      pull << (result.estimate.value - analytic) / result.estimate.error;
+      if (dim == 1) pull.str("exact"); // Not sampled, see run_ball
+      else if (hits < ball_min_hits) {
+        pull.str("n/a");
+        sparse.push_back(dim);
+      }
+      std::cout << "LOG: " << dim << ", " << result.nPoints << ", " << hits << ", " << result.estimate.value << ", " << error_text(result.estimate.error) << ", " << analytic << ", " << pull.str() << ", " << error_text(result.nPoints / result.seconds / 1e9) << std::endl;
+    }
+    if (!sparse.empty()) {
+      std::cout << "LOG: WARNING: fewer than " << ball_min_hits << " points landed inside the ball for D =";
+      for (int dim : sparse) std::cout << " " << dim;
+      std::cout << ", their estimates and errors are unreliable. The hit fraction falls roughly like the analytic volume over 2^D, use more points." << std::endl;
     }
+    if (!args.convergence.empty()) std::cout << "LOG: " << log.nRows() << " checkpoints written to " << args.convergence << std::endl;
+    std::cout << std::endl;
+    return 0;
   }
 
-  std::cout << "LOG: Number of points in circle = " << nInCircle << " out of " << args.nRandomPoints << std::endl;
-
-  // Calculate pi and error
-  double pi = 4.0 * nInCircle / args.nRandomPoints;
-  double piError = error(pi);
+  std::vector<std::string> modes = {args.mode};
+  if (args.mode == "all") modes = {"plain", "antithetic", "stratified", "sobol"};
+  std::vector<ModeResult> results;
+  for (std::string mode : modes) results.push_back(run_mode(args, mode, log));
+  if (!args.convergence.empty()) std::cout << "LOG: " << log.nRows() << " checkpoints written to " << args.convergence << std::endl;
 
   // Log results
   std::cout << std::fixed; // Show trailing zeros
   std::cout.precision(10); // Set precision to 10 decimal places
-  std::cout << "LOG: Estimated π (pi) = " << pi << std::endl;
-  std::cout << "LOG: Percentage Error = " << piError << "%" << std::endl;
+  if (results.size() == 1) {
+    const ModeResult &result = results[0];
+    std::cout << "LOG: " << result.nPoints << " points (" << result.mode << ") in " << result.seconds << " s on " << result.nThreads << " threads (" << result.nPoints / result.seconds / 1e9 << " points/ns)" << std::endl;
+    double piError = error(result.estimate.value);
+    std::cout << "LOG: Estimated π (pi) = " << result.estimate.value << std::endl;
+    std::cout << "LOG: Standard Error   = " << error_text(result.estimate.error) << std::endl;
+    std::cout << "LOG: Error per second = " << error_text(result.errorPerSecond()) << " (standard error after one thread-second)" << std::endl;
+    std::cout << "LOG: Percentage Error = " << piError << "%" << std::endl;
+  }
+  else { // Compare the modes, efficiency is how many times fewer thread-seconds than plain a given error needs
+    std::cout << std::endl << "LOG: mode, points, estimate, standard error, seconds, error per second, efficiency vs plain" << std::endl;
+    double plain = results[0].errorPerSecond();
+    for (const ModeResult &result : results) {
+      double efficiency = (plain * plain) / (result.errorPerSecond() * result.errorPerSecond());
+      std::cout << "LOG: " << result.mode << ", " << result.nPoints << ", " << result.estimate.value << ", " << error_text(result.estimate.error) << ", " << result.seconds << ", " << error_text(result.errorPerSecond()) << ", " << (std::isnan(efficiency) ? "n/a" : "x" + error_text(efficiency)) << std::endl;
+    }
+  }
   std::cout << std::endl;
 
   return 0;